@@ -0,0 +1,191 @@
+/**
+ * @file  bench.h
+ *
+ * @brief Timing, allocation counting and output shared by the benchmarks.
+ *
+ * Every benchmark prints a table by default. With --json it prints one
+ * JSON object per result instead, so runs can be collected and compared
+ * by scripts. Results carry heap allocations per operation, counted by
+ * the global operator new defined here, so this header must be included
+ * by exactly one source file of a benchmark.
+ */
+
+#ifndef _BENCH_H
+#define _BENCH_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace bench
+{
+
+	inline std::atomic<long> allocations = 0;
+
+	/**
+	 * @brief Time and allocations per operation
+	 */
+	struct result
+	{
+		double ns;
+		double allocs;
+	};
+
+	/**
+	 * @brief Run f, which does ops operations, and measure it
+	 */
+	template <typename F>
+	result
+	measure(long ops, F&& f)
+	{
+		long before = allocations.load(std::memory_order_relaxed);
+		auto start = std::chrono::steady_clock::now();
+		f();
+		auto end = std::chrono::steady_clock::now();
+		long allocs = allocations.load(std::memory_order_relaxed) - before;
+
+		return {std::chrono::duration<double, std::nano>(end - start).count() / ops,
+			(double)allocs / ops};
+	}
+
+	typedef std::vector<std::pair<std::string, double>> fields;
+
+	/**
+	 * @brief Prints results as a table or as JSON lines
+	 *
+	 * Each result is a case name, its parameters and its metrics. Table
+	 * header is printed again whenever the columns change.
+	 */
+	class report
+	{
+	public:
+		/**
+		 * @brief Take --json out of the arguments
+		 *
+		 * @param name Benchmark name, put into every JSON line
+		 */
+		report(const char* name, int& argc, char** argv)
+		: _name(name)
+		{
+			int out = 1;
+			for (int i = 1; i < argc; i++) {
+				if (std::strcmp(argv[i], "--json") == 0)
+					_json = true;
+				else
+					argv[out++] = argv[i];
+			}
+			argc = out;
+		}
+
+		void
+		add(const std::string& name, const fields& params, const fields& metrics)
+		{
+			if (_json)
+				add_json(name, params, metrics);
+			else
+				add_row(name, params, metrics);
+		}
+
+		void
+		add(const std::string& name, const fields& params, const result& r)
+		{ add(name, params, {{"ns_per_op", r.ns}, {"allocs_per_op", r.allocs}}); }
+
+	private:
+		std::string _name;
+		bool _json = false;
+		std::vector<std::string> _columns;
+
+		static std::string
+		number(double v)
+		{
+			std::ostringstream o;
+			if (v == (long long)v && v < 1e15 && v > -1e15)
+				o << (long long)v;
+			else
+				o << std::fixed << std::setprecision(v < 10 ? 3 : 1) << v;
+			return o.str();
+		}
+
+		void
+		add_json(const std::string& name, const fields& params, const fields& metrics)
+		{
+			std::cout << "{\"bench\": \"" << _name << "\", \"case\": \"" << name << "\"";
+			for (auto& [k, v]: params)
+				std::cout << ", \"" << k << "\": " << number(v);
+			for (auto& [k, v]: metrics)
+				std::cout << ", \"" << k << "\": " << number(v);
+			std::cout << "}" << std::endl;
+		}
+
+		void
+		add_row(const std::string& name, const fields& params, const fields& metrics)
+		{
+			std::vector<std::string> columns{"case"};
+			for (auto& f: params)
+				columns.push_back(f.first);
+			for (auto& f: metrics)
+				columns.push_back(f.first);
+
+			if (columns != _columns) {
+				_columns = columns;
+				std::cout << std::setw(32) << std::left << columns[0] << std::right;
+				for (std::size_t i = 1; i < columns.size(); i++)
+					std::cout << std::setw(15) << columns[i];
+				std::cout << std::endl;
+			}
+
+			std::cout << std::setw(32) << std::left << name << std::right;
+			for (auto& f: params)
+				std::cout << std::setw(15) << number(f.second);
+			for (auto& f: metrics)
+				std::cout << std::setw(15) << number(f.second);
+			std::cout << std::endl;
+		}
+	};
+
+}
+
+void*
+operator new(std::size_t size)
+{
+	bench::allocations.fetch_add(1, std::memory_order_relaxed);
+	if (void* p = std::malloc(size ? size : 1))
+		return p;
+	throw std::bad_alloc();
+}
+
+void*
+operator new(std::size_t size, std::align_val_t align)
+{
+	bench::allocations.fetch_add(1, std::memory_order_relaxed);
+	std::size_t a = static_cast<std::size_t>(align);
+	if (void* p = std::aligned_alloc(a, (size + a - 1) / a * a))
+		return p;
+	throw std::bad_alloc();
+}
+
+void
+operator delete(void* p) noexcept
+{ std::free(p); }
+
+void
+operator delete(void* p, std::size_t) noexcept
+{ std::free(p); }
+
+void
+operator delete(void* p, std::align_val_t) noexcept
+{ std::free(p); }
+
+void
+operator delete(void* p, std::size_t, std::align_val_t) noexcept
+{ std::free(p); }
+
+#endif
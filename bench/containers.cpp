@@ -0,0 +1,100 @@
+/**
+ * @file  containers.cpp
+ *
+ * @brief Benchmark of single operations on every versioned container.
+ *
+ * "push" fills an empty container, "read" looks elements up (front/top
+ * for queue and stack), std:: containers give the baseline. All of it
+ * happens in one Segment, so it is the overhead of the wrappers.
+ *
+ * "first write" is one insert right after a fork, where the value is
+ * not ours yet: std:: backends copy the whole container, persistent
+ * ones share it and copy only the path they change.
+ */
+
+#include <cstdlib>
+#include <memory>
+#include <queue>
+#include <set>
+#include <stack>
+#include <string>
+#include <utility>
+
+#include "bench.h"
+#include "revision.h"
+#include "vs_queue.h"
+#include "vs_set.h"
+#include "vs_stack.h"
+#include "vs_tree.h"
+
+static long sink = 0;
+
+/* keys spread over the whole range, so trees do not get sorted input */
+static int
+key(long i)
+{ return (int)((i * 2654435761u) % 1000003); }
+
+template <typename C, typename Push, typename Read>
+static void
+run(bench::report& report, const std::string& name, long size, int rounds, Push&& push, Read&& read)
+{
+	auto c = std::make_unique<C>();
+
+	report.add(name + " push", {{"size", size}}, bench::measure(size, [&]() {
+		for (long i = 0; i < size; i++)
+			push(*c, key(i));
+	}));
+
+	report.add(name + " read", {{"size", size}}, bench::measure(size, [&]() {
+		for (long i = 0; i < size; i++)
+			sink += read(*c, key(i));
+	}));
+
+	if constexpr (requires { c->snapshot(); }) {
+		bench::result total = {0, 0};
+		for (int r = 0; r < rounds; r++) {
+			std::shared_ptr<Revision> forked = ForkRevision();
+			std::swap(Revision::currentRevision, forked);
+			bench::result write = bench::measure(1, [&]() { push(*c, key(size + r)); });
+			std::swap(Revision::currentRevision, forked);
+			JoinRevision(forked);
+
+			total.ns += write.ns;
+			total.allocs += write.allocs;
+		}
+		report.add(name + " first write", {{"size", size}}, {{"ns_per_op", total.ns / rounds},
+			{"allocs_per_op", total.allocs / rounds}});
+	}
+}
+
+int
+main(int argc, char** argv)
+{
+	bench::report report("containers", argc, argv);
+	const long size = argc > 1 ? std::atol(argv[1]) : 100000;
+	const int rounds = argc > 2 ? std::atoi(argv[2]) : 100;
+
+	auto insert = [](auto& c, int k) { c.insert(k); };
+	auto push = [](auto& c, int k) { c.push(k); };
+	auto contains = [](auto& c, int k) { return (long)(c.find(k) != c.end()); };
+
+	run<std::set<int>>(report, "std::set", size, rounds, insert, contains);
+	run<vs::vs_set<int>>(report, "vs_set", size, rounds, insert, contains);
+	run<vs::vs_set<int, std::less<int>, vs::vs_set_strategy<int, std::less<int>>,
+		vs::persistent_set<int>>>(report, "vs_set persistent", size, rounds, insert, contains);
+	run<vs::vs_tree<int>>(report, "vs_tree", size, rounds, push, contains);
+
+	auto front = [](auto& c, int) { return (long)c.front(); };
+	run<std::queue<int>>(report, "std::queue", size, rounds, push, front);
+	run<vs::vs_queue<int>>(report, "vs_queue", size, rounds, push, front);
+	run<vs::vs_queue<int, vs::vs_queue_strategy<int>, vs::persistent_queue<int>>>(
+		report, "vs_queue persistent", size, rounds, push, front);
+
+	auto top = [](auto& c, int) { return (long)c.top(); };
+	run<std::stack<int>>(report, "std::stack", size, rounds, push, top);
+	run<vs::vs_stack<int>>(report, "vs_stack", size, rounds, push, top);
+	run<vs::vs_stack<int, vs::vs_stack_strategy<int>, vs::persistent_stack<int>>>(
+		report, "vs_stack persistent", size, rounds, push, top);
+
+	return sink == 0;
+}
@@ -0,0 +1,98 @@
+/**
+ * @file  contention.cpp
+ *
+ * @brief Benchmark of versioned containers against mutex-protected std:: ones.
+ *
+ * Every thread inserts its own keys into one shared container. std::
+ * containers are locked for every operation, versioned ones are written
+ * by vs::threads in their own Revisions without locks, and all their
+ * work is merged when they are joined. Time includes starting and
+ * joining the threads, so the merge cost is counted as well.
+ */
+
+#include <cstdlib>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench.h"
+#include "vs_queue.h"
+#include "vs_set.h"
+#include "vs_thread.h"
+#include "vs_tree.h"
+
+template <typename C, typename Push>
+static bool
+locked(bench::report& report, const std::string& name, int threads, long ops, Push&& push)
+{
+	C c;
+	std::mutex m;
+
+	bench::result r = bench::measure(threads * ops, [&]() {
+		std::vector<std::thread> workers;
+		for (int t = 0; t < threads; t++) {
+			workers.emplace_back([&, t]() {
+				for (long i = 0; i < ops; i++) {
+					std::lock_guard<std::mutex> lock(m);
+					push(c, (int)(t * ops + i));
+				}
+			});
+		}
+		for (auto& w: workers)
+			w.join();
+	});
+
+	report.add(name, {{"threads", threads}}, {{"ops_per_s", 1e9 / r.ns}, {"ns_per_op", r.ns},
+		{"allocs_per_op", r.allocs}});
+	return (long)c.size() == threads * ops;
+}
+
+template <typename C, typename Push>
+static bool
+versioned(bench::report& report, const std::string& name, int threads, long ops, Push&& push)
+{
+	C c;
+
+	bench::result r = bench::measure(threads * ops, [&]() {
+		std::vector<vs::thread> workers;
+		for (int t = 0; t < threads; t++) {
+			workers.emplace_back([&, t]() {
+				for (long i = 0; i < ops; i++)
+					push(c, (int)(t * ops + i));
+			});
+		}
+		for (auto& w: workers)
+			w.join();
+	});
+
+	report.add(name, {{"threads", threads}}, {{"ops_per_s", 1e9 / r.ns}, {"ns_per_op", r.ns},
+		{"allocs_per_op", r.allocs}});
+	return (long)c.size() == threads * ops;
+}
+
+int
+main(int argc, char** argv)
+{
+	bench::report report("contention", argc, argv);
+	const int hw = (int)std::thread::hardware_concurrency();
+	const int max_threads = argc > 1 ? std::atoi(argv[1]) : (hw > 1 ? hw : 2);
+	const long ops = argc > 2 ? std::atol(argv[2]) : 20000;
+	bool ok = true;
+
+	auto insert = [](auto& c, int k) { c.insert(k); };
+	auto push = [](auto& c, int k) { c.push(k); };
+
+	for (int threads = 1; threads <= max_threads; threads *= 2) {
+		ok &= locked<std::set<int>>(report, "std::set + mutex", threads, ops, insert);
+		ok &= versioned<vs::vs_set<int>>(report, "vs_set", threads, ops, insert);
+		ok &= versioned<vs::vs_tree<int>>(report, "vs_tree", threads, ops, push);
+		ok &= locked<std::queue<int>>(report, "std::queue + mutex", threads, ops, push);
+		ok &= versioned<vs::vs_queue<int>>(report, "vs_queue", threads, ops, push);
+	}
+
+	return ok ? 0 : 1;
+}
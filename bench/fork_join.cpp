@@ -0,0 +1,53 @@
+/**
+ * @file  fork_join.cpp
+ *
+ * @brief Benchmark of a single fork+join cycle.
+ *
+ * Child writes one variable, so the join has something to merge. Besides
+ * time, it counts heap allocations per cycle. The OS thread behind
+ * vs::thread costs one of them, everything else should come from pools.
+ * Same cycle is measured with vs::task, which runs on the worker pool.
+ */
+
+#include <cstdlib>
+
+#include "bench.h"
+#include "versioned.h"
+#include "vs_task.h"
+#include "vs_thread.h"
+
+template <typename Cycle>
+static void
+measure(bench::report& report, const char* name, int cycles, Cycle&& cycle)
+{
+	const int warmup = 1000;
+
+	for (int i = 0; i < warmup; i++)
+		cycle();
+
+	report.add(name, {{"cycles", cycles}}, bench::measure(cycles, [&]() {
+		for (int i = 0; i < cycles; i++)
+			cycle();
+	}));
+}
+
+int
+main(int argc, char** argv)
+{
+	bench::report report("fork_join", argc, argv);
+	const int cycles = argc > 1 ? std::atoi(argv[1]) : 20000;
+
+	Versioned<int> x(0);
+
+	measure(report, "vs::thread", cycles, [&x]() {
+		vs::thread child([&x]() { x.Set(x.Get() + 1); });
+		child.join();
+	});
+
+	measure(report, "vs::task", cycles, [&x]() {
+		vs::task child([&x]() { x.Set(x.Get() + 1); });
+		child.join();
+	});
+
+	return x.Get() == 2 * (1000 + cycles) ? 0 : 1;
+}
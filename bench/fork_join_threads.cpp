@@ -0,0 +1,52 @@
+/**
+ * @file  fork_join_threads.cpp
+ *
+ * @brief Stress benchmark of concurrent forks and joins.
+ *
+ * Every driver thread forks and joins children in a loop, all of them
+ * from the same root Segment and writing the same variable, so Segment
+ * refcounts, version ids and version slots are hit from many threads.
+ */
+
+#include <cstdlib>
+#include <vector>
+
+#include "bench.h"
+#include "versioned.h"
+#include "vs_thread.h"
+
+int
+main(int argc, char** argv)
+{
+	bench::report report("fork_join_threads", argc, argv);
+	const int max_threads = argc > 1 ? std::atoi(argv[1]) : 64;
+	const int forks = argc > 2 ? std::atoi(argv[2]) : 200;
+
+	Versioned<long> x(0);
+	long rounds = 0;
+
+	for (int threads = 1; threads <= max_threads; threads *= 2) {
+		long total = (long)threads * forks;
+
+		bench::result r = bench::measure(total, [&]() {
+			std::vector<vs::thread> drivers;
+			for (int t = 0; t < threads; t++) {
+				drivers.emplace_back([&x, forks]() {
+					for (int i = 0; i < forks; i++) {
+						vs::thread child([&x]() { x.Set(x.Get() + 1); });
+						child.join();
+					}
+				});
+			}
+			for (auto& d: drivers)
+				d.join();
+		});
+		rounds++;
+
+		report.add("fork+join", {{"threads", threads}},
+			{{"per_s", 1e9 / r.ns}, {"ns_per_op", r.ns}, {"allocs_per_op", r.allocs}});
+	}
+
+	/* every driver adds forks to what it saw, and the last join wins */
+	return x.Get() == rounds * forks ? 0 : 1;
+}
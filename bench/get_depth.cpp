@@ -0,0 +1,61 @@
+/**
+ * @file  get_depth.cpp
+ *
+ * @brief Benchmark of Versioned::Get latency against Segment chain depth.
+ *
+ * Every fork adds a Segment to the chain of the forking Revision, and
+ * the chain is not collapsed while forked threads are not joined. Values
+ * are written at the bottom of the chain and read at its top.
+ *
+ * "hot" reads the same variable again and again, so it is served from
+ * the read cache. "cold" reads more variables than the cache holds, so
+ * every Get has to find the nearest version in the chain.
+ */
+
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+#include "bench.h"
+#include "versioned.h"
+#include "vs_thread.h"
+
+static long sink = 0;
+
+int
+main(int argc, char** argv)
+{
+	bench::report report("get_depth", argc, argv);
+	const int max_depth = argc > 1 ? std::atoi(argv[1]) : 1024;
+	const int nvars = 4096;
+	const long reads = 1 << 20;
+
+	std::vector<std::unique_ptr<Versioned<int>>> vars;
+	for (int i = 0; i < nvars; i++)
+		vars.push_back(std::make_unique<Versioned<int>>(i));
+
+	std::vector<vs::thread> forks;
+	auto base = Revision::currentRevision->current->depth;
+
+	for (int depth = 0; depth <= max_depth; depth = depth ? depth * 2 : 1) {
+		while (Revision::currentRevision->current->depth - base < depth)
+			forks.emplace_back([]() {});
+
+		bench::result hot = bench::measure(reads, [&]() {
+			for (long i = 0; i < reads; i++)
+				sink += vars[0]->Get();
+		});
+		bench::result cold = bench::measure(reads, [&]() {
+			for (long i = 0; i < reads; i++)
+				sink += vars[i % nvars]->Get();
+		});
+
+		report.add("Get", {{"depth", depth}}, {{"hot_ns", hot.ns}, {"cold_ns", cold.ns},
+			{"allocs_per_op", hot.allocs + cold.allocs}});
+	}
+
+	for (auto& t: forks)
+		t.join();
+
+	return sink == 0;
+}
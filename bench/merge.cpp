@@ -0,0 +1,85 @@
+/**
+ * @file  merge.cpp
+ *
+ * @brief Benchmark of join time against container size and merge strategy.
+ *
+ * A container of the given size is forked, both the forked Revision and
+ * its parent add a few elements, so the join has to run the strategy
+ * instead of just taking the child's version. Only JoinRevision is timed.
+ * Default strategies walk the whole child's value, splice strategy of
+ * persistent_stack only links it.
+ */
+
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "bench.h"
+#include "revision.h"
+#include "vs_queue.h"
+#include "vs_set.h"
+#include "vs_stack.h"
+#include "vs_tree.h"
+
+/* elements written on each side of the fork */
+static const int writes = 16;
+
+template <typename C, typename Push>
+static bool
+run(bench::report& report, const std::string& name, long size, int rounds, Push&& push)
+{
+	bench::result total = {0, 0};
+	bool ok = true;
+
+	for (int r = 0; r < rounds; r++) {
+		/* strategies may duplicate elements, so every round starts over */
+		auto c = std::make_unique<C>();
+		for (long i = 0; i < size; i++)
+			push(*c, (int)i);
+
+		std::shared_ptr<Revision> forked = ForkRevision();
+		std::swap(Revision::currentRevision, forked);
+		for (int i = 0; i < writes; i++)
+			push(*c, (int)(size + i));
+		std::swap(Revision::currentRevision, forked);
+		for (int i = 0; i < writes; i++)
+			push(*c, (int)(size + writes + i));
+
+		bench::result join = bench::measure(1, [&]() { JoinRevision(forked); });
+		total.ns += join.ns;
+		total.allocs += join.allocs;
+		ok &= (long)c->size() >= size + 2 * writes;
+	}
+
+	report.add(name, {{"size", size}}, {{"join_us", total.ns / rounds / 1e3},
+		{"allocs_per_op", total.allocs / rounds}});
+	return ok;
+}
+
+int
+main(int argc, char** argv)
+{
+	bench::report report("merge", argc, argv);
+	const long max_size = argc > 1 ? std::atol(argv[1]) : 16384;
+	const int rounds = argc > 2 ? std::atoi(argv[2]) : 10;
+	bool ok = true;
+
+	auto insert = [](auto& c, int k) { c.insert(k); };
+	auto push = [](auto& c, int k) { c.push(k); };
+
+	for (long size = 16; size <= max_size; size *= 4) {
+		ok &= run<vs::vs_set<int>>(report, "vs_set", size, rounds, insert);
+		ok &= run<vs::vs_set<int, std::less<int>, vs::vs_set_strategy<int, std::less<int>>,
+			vs::persistent_set<int>>>(report, "vs_set persistent", size, rounds, insert);
+		ok &= run<vs::vs_tree<int>>(report, "vs_tree", size, rounds, push);
+		ok &= run<vs::vs_queue<int>>(report, "vs_queue", size, rounds, push);
+		ok &= run<vs::vs_queue<int, vs::vs_queue_strategy<int>, vs::persistent_queue<int>>>(
+			report, "vs_queue persistent", size, rounds, push);
+		ok &= run<vs::vs_stack<int>>(report, "vs_stack", size, rounds, push);
+		ok &= run<vs::vs_stack<int, vs::vs_stack_splice_strategy<int>, vs::persistent_stack<int>>>(
+			report, "vs_stack splice", size, rounds, push);
+	}
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,90 @@
+/**
+ * @file  parallel_merge.cpp
+ *
+ * @brief Benchmark of joining a Revision that wrote many variables.
+ *
+ * The forked Revision writes every variable and is joined back, once
+ * with all merging done by the joining thread and once split between
+ * pool workers. Only JoinRevision itself is timed. Small values show
+ * the cost of splitting, large values show what it saves.
+ */
+
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "bench.h"
+#include "revision.h"
+#include "versioned.h"
+#include "vs_task.h"
+
+/* fork, step every variable in the forked Revision and time the join */
+template <typename T, typename F>
+static bench::result
+join_ms(std::vector<std::unique_ptr<Versioned<T>>>& vars, int rounds, F&& step)
+{
+	bench::result total = {0, 0};
+
+	for (int r = 0; r < rounds; r++) {
+		std::shared_ptr<Revision> forked = ForkRevision();
+		std::swap(Revision::currentRevision, forked);
+		for (auto& v: vars)
+			v->Set(step(v->Get()));
+		std::swap(Revision::currentRevision, forked);
+
+		bench::result join = bench::measure(1, [&]() { JoinRevision(forked); });
+		total.ns += join.ns / 1e6;
+		total.allocs += join.allocs;
+	}
+	return {total.ns / rounds, total.allocs / rounds};
+}
+
+template <typename T, typename F>
+static bool
+run(bench::report& report, const std::string& name, int count, int rounds, const T& init, F&& step)
+{
+	std::vector<std::unique_ptr<Versioned<T>>> vars;
+	for (int i = 0; i < count; i++)
+		vars.push_back(std::make_unique<Versioned<T>>(init));
+
+	std::size_t cutoff = GetParallelMergeCutoff();
+
+	SetParallelMergeCutoff(SIZE_MAX);
+	bench::result serial = join_ms(vars, rounds, step);
+	SetParallelMergeCutoff(0);
+	bench::result parallel = join_ms(vars, rounds, step);
+	SetParallelMergeCutoff(cutoff);
+
+	report.add(name, {{"variables", count}, {"threads", vs::WorkerPool::instance().size() + 1}},
+		{{"serial_ms", serial.ns}, {"parallel_ms", parallel.ns}, {"speedup", serial.ns / parallel.ns},
+		{"serial_allocs", serial.allocs}, {"parallel_allocs", parallel.allocs}});
+
+	/* both runs step each variable once per round */
+	T expected = init;
+	for (int r = 0; r < 2 * rounds; r++)
+		expected = step(expected);
+	for (auto& v: vars)
+		if (v->Get() != expected)
+			return false;
+	return true;
+}
+
+int
+main(int argc, char** argv)
+{
+	bench::report report("parallel_merge", argc, argv);
+	const int count = argc > 1 ? std::atoi(argv[1]) : 10000;
+	const int rounds = argc > 2 ? std::atoi(argv[2]) : 20;
+
+	bool ok = run(report, "int", count, rounds, 0, [](int v) { return v + 1; });
+
+	ok &= run(report, "vector[256]", count, rounds, std::vector<int>(256), [](std::vector<int> v) {
+		v[0]++;
+		return v;
+	});
+
+	return ok ? 0 : 1;
+}
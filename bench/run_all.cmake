@@ -0,0 +1,29 @@
+# Runs every benchmark with --json and collects the results.
+#
+# BENCHES - comma-separated paths of benchmark executables
+# OUTPUT  - file to write, one JSON object per line
+
+file(WRITE ${OUTPUT} "")
+string(REPLACE "," ";" BENCHES "${BENCHES}")
+
+set(FAILED)
+foreach(BENCH ${BENCHES})
+    get_filename_component(NAME ${BENCH} NAME)
+    message(STATUS "Running ${NAME}")
+    execute_process(COMMAND ${BENCH} --json OUTPUT_VARIABLE OUT RESULT_VARIABLE RC)
+
+    # anything that is not a result is dropped
+    string(REGEX MATCHALL "{[^\n]*}\n" LINES "${OUT}")
+    foreach(LINE ${LINES})
+        file(APPEND ${OUTPUT} "${LINE}")
+    endforeach()
+
+    if(NOT RC EQUAL 0)
+        list(APPEND FAILED ${NAME})
+    endif()
+endforeach()
+
+if(FAILED)
+    message(FATAL_ERROR "Benchmarks failed their checks: ${FAILED}")
+endif()
+message(STATUS "Results written to ${OUTPUT}")
@@ -0,0 +1,58 @@
+/**
+ * @file  update.cpp
+ *
+ * @brief Benchmark of in-place writes through Versioned::Set and Update.
+ *
+ * "Set" is the old write path of the containers: current value is read
+ * with Get and passed along with an updater wrapped in std::function.
+ * "Update" takes the updater as a template argument. Both write into a
+ * version that already exists in the current Segment, so the numbers
+ * are the per-write overhead on top of the operation itself.
+ */
+
+#include <cstdlib>
+#include <set>
+#include <string>
+
+#include "bench.h"
+#include "versioned.h"
+
+static void
+report_pair(bench::report& report, const std::string& name, long ops,
+	const bench::result& set, const bench::result& update)
+{
+	report.add(name, {{"ops", ops}}, {{"set_ns", set.ns}, {"update_ns", update.ns},
+		{"speedup", set.ns / update.ns}, {"set_allocs", set.allocs}, {"update_allocs", update.allocs}});
+}
+
+int
+main(int argc, char** argv)
+{
+	bench::report report("update", argc, argv);
+	const long ops = argc > 1 ? std::atol(argv[1]) : 1 << 20;
+
+	Versioned<long> x(0);
+	bench::result set = bench::measure(ops, [&]() {
+		for (long i = 0; i < ops; i++)
+			x.Set(x.Get(), [&](long& v) { v += i; return true; });
+	});
+	bench::result update = bench::measure(ops, [&]() {
+		for (long i = 0; i < ops; i++)
+			x.Update([&](long& v) { v += i; return true; });
+	});
+	report_pair(report, "long +=", ops, set, update);
+
+	/* same keys in both runs, so the sets are of the same size */
+	Versioned<std::set<long>> s(std::set<long>{});
+	set = bench::measure(ops, [&]() {
+		for (long i = 0; i < ops; i++)
+			s.Set(s.Get(), [&](std::set<long>& v) { return v.insert(i % 1024).second; });
+	});
+	update = bench::measure(ops, [&]() {
+		for (long i = 0; i < ops; i++)
+			s.Update([&](std::set<long>& v) { return v.insert(i % 1024).second; });
+	});
+	report_pair(report, "set insert", ops, set, update);
+
+	return x.Get() == 0 || s.Get().size() != 1024;
+}
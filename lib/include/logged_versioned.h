@@ -0,0 +1,353 @@
+/**
+ * @file  logged_versioned.h
+ *
+ * @brief Implementation of the LoggedVersioned class.
+ */
+
+#ifndef __LOGGED_VERSIONED_H__
+#define __LOGGED_VERSIONED_H__
+
+#include <functional>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+#include "versioned.h"
+
+/**
+ * @brief Versioned wrapper that records operations instead of copies
+ *
+ * Versioned copies the whole object on the first write in every Segment.
+ * LoggedVersioned stores only the operations applied in a Segment, and
+ * reads resolve against the nearest materialized value. Object is
+ * materialized in a Segment only when it is read there after a write.
+ * On join, child's operations are replayed on top of the parent's value,
+ * so merge cost is proportional to the work done in the child.
+ *
+ * Operations are stored, so they must own everything they capture.
+ *
+ * Revisions of different threads add and remove entries at the same
+ * time, so the map is guarded by a mutex. Entry is changed only by the
+ * Revision owning its Segment, or by Fold, which may change entries of
+ * Segments shared with running forks. So Get walks the chain and
+ * applies pending operations under the same lock that Fold holds.
+ *
+ * @tparam T Class that needs to be versioned
+ */
+template <class T>
+class LoggedVersioned : public VersionedI {
+public:
+	/**
+	 * @brief Operation applied to the object
+	 */
+	typedef std::function<void(T&)> Operation;
+
+	/**
+	 * @brief What was done to the object in one Segment
+	 */
+	struct Entry {
+		/**
+		 * @brief Materialized value as seen in the Segment, if any
+		 */
+		std::optional<T> value;
+
+		/**
+		 * @brief Operations applied in the Segment, in order
+		 */
+		std::vector<Operation> log;
+	};
+
+	/**
+	 * @brief Map of all Segments where object was changed or materialized
+	 *
+	 * @details Segment versions are used as a keys, nodes keep their
+	 *          addresses, so entries are used after the lock is released
+	 * @see Segment
+	 */
+	mutable std::map<Segment::version_type, Entry> versions;
+
+	/**
+	 * @brief Construct a new LoggedVersioned object from your object
+	 *
+	 * @param val Your object
+	 */
+	LoggedVersioned(const T& val);
+
+	/**
+	 * @brief Destroy the LoggedVersioned object
+	 *
+	 * Removes all mentions of that versioned object in current Revision
+	 */
+	~LoggedVersioned();
+
+	/**
+	 * @brief Get the current value of the object in the current Revision
+	 *
+	 * If operations were logged since the nearest materialized value, they
+	 * are applied to a copy of it, which is kept in the current Segment.
+	 *
+	 * @throws std::out_of_range if object has no value in the Revision
+	 * @return T Object value
+	 */
+	const T& Get() const;
+
+	/**
+	 * @brief Log an operation in the current Revision
+	 *
+	 * @param op Operation, applied right away only if value is materialized
+	 */
+	void Apply(Operation op);
+
+	/**
+	 * @brief Log overwrite of the object
+	 *
+	 * @param v New object value
+	 */
+	void Set(const T& v);
+
+	/**
+	 * @brief Forget what was done in some Segment
+	 *
+	 * @param release Segment to forget
+	 */
+	void Release(std::shared_ptr<Segment> release) override;
+
+	/**
+	 * @brief Fold parent Segment's log into current Segment of main
+	 *
+	 * @param main Revision to start collapsing from
+	 * @param parent Segment that is collapsed
+	 */
+	void Collapse(std::shared_ptr<Revision> main, std::shared_ptr<Segment> parent) override;
+
+	/**
+	 * @brief Replay operations of joined Revision in main Revision
+	 *
+	 * @param main Revision to merge into
+	 * @param joinRev Revision to merge
+	 * @param join Segment of joinRev that is merged
+	 * @return bool Whether any operation was logged in main
+	 */
+	bool Merge(std::shared_ptr<Revision> main, std::shared_ptr<Revision> joinRev, std::shared_ptr<Segment> join) override;
+
+	/**
+	 * @brief Fold unshared parent Segment's log into its only child
+	 *
+	 * @param main Revision whose chain has both Segments
+	 * @param parent Segment that is folded
+	 * @param child Segment whose parent it is
+	 */
+	void Fold(std::shared_ptr<Revision> main, std::shared_ptr<Segment> parent, std::shared_ptr<Segment> child) override;
+
+private:
+
+	/**
+	 * @brief Guards structure of versions, and entries during Get and Fold
+	 */
+	mutable std::mutex mutex;
+
+	/**
+	 * @brief Get entry of the Segment, nullptr if there is none
+	 */
+	Entry* Find(Segment::version_type version) const;
+
+	/**
+	 * @brief Get entry of the current Segment, creating it if needed
+	 */
+	Entry& Current(std::shared_ptr<Revision> r) const;
+
+	/**
+	 * @brief Log an operation in specified Revision
+	 */
+	void Apply(std::shared_ptr<Revision> r, Operation op);
+};
+
+
+template <class T>
+LoggedVersioned<T>::LoggedVersioned(const T& val) {
+	Current(Revision::currentRevision).value = val;
+}
+
+template <class T>
+LoggedVersioned<T>::~LoggedVersioned() {
+	std::shared_ptr<Segment> s = Revision::currentRevision->current;
+
+	while (s) {
+		if (Find(s->version))
+			s->written.erase(this);
+		s = s->parent;
+	}
+
+	if constexpr (statsEnabled) {
+		std::lock_guard<std::mutex> lock(mutex);
+		Stats::Released(versions.size());
+	}
+}
+
+template <class T>
+typename LoggedVersioned<T>::Entry* LoggedVersioned<T>::Find(Segment::version_type version) const {
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = versions.find(version);
+	return it == versions.end() ? nullptr : &it->second;
+}
+
+template <class T>
+typename LoggedVersioned<T>::Entry& LoggedVersioned<T>::Current(std::shared_ptr<Revision> r) const {
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = versions.find(r->current->version);
+	if (it == versions.end()) {
+		r->current->written.insert(const_cast<LoggedVersioned*>(this));
+		it = versions.emplace(r->current->version, Entry()).first;
+		Stats::Created(versions.size());
+	}
+	return it->second;
+}
+
+template <class T>
+const T& LoggedVersioned<T>::Get() const {
+	std::shared_ptr<Segment> s = Revision::currentRevision->current;
+	std::vector<const Entry*> pending;
+	const Entry* base;
+	/* Fold must not move entries between Segments in the middle of the walk */
+	std::unique_lock<std::mutex> lock(mutex);
+
+	/* walk up until a value, remembering logs on the way */
+	while (true) {
+		if (!s)
+			throw std::out_of_range("LoggedVersioned::Get");
+		auto it = versions.find(s->version);
+		if (it != versions.end()) {
+			const Entry& e = it->second;
+			if (e.value) {
+				if (pending.empty())
+					return *e.value;
+				base = &e;
+				break;
+			}
+			pending.push_back(&e);
+		}
+		s = s->parent;
+	}
+
+	T value = *base->value;
+	Stats::Copy(StatsBytes(value));
+	for (auto e = pending.rbegin(); e != pending.rend(); ++e)
+		for (auto& op: (*e)->log)
+			op(value);
+	lock.unlock();
+
+	Entry& cur = Current(Revision::currentRevision);
+	cur.value = std::move(value);
+	return *cur.value;
+}
+
+template <class T>
+void LoggedVersioned<T>::Apply(Operation op) {
+	Apply(Revision::currentRevision, std::move(op));
+}
+
+template <class T>
+void LoggedVersioned<T>::Apply(std::shared_ptr<Revision> r, Operation op) {
+	Entry& e = Current(r);
+	if (e.value)
+		op(*e.value);
+	e.log.push_back(std::move(op));
+}
+
+template <class T>
+void LoggedVersioned<T>::Set(const T& v) {
+	Apply([v](T& value) { value = v; });
+}
+
+template <class T>
+void LoggedVersioned<T>::Release(std::shared_ptr<Segment> release) {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (versions.erase(release->version))
+		Stats::Released();
+}
+
+template <class T>
+void LoggedVersioned<T>::Collapse(std::shared_ptr<Revision> main, std::shared_ptr<Segment> parent) {
+	Entry* p = Find(parent->version);
+	if (!p)
+		return;
+
+	Stats::CollapseTimer<LoggedVersioned> timer;
+
+	Entry& cur = Current(main);
+	if (!cur.value && p->value) {
+		cur.value = std::move(p->value);
+		for (auto& op: cur.log)
+			op(*cur.value);
+	}
+	cur.log.insert(cur.log.begin(), std::make_move_iterator(p->log.begin()),
+		std::make_move_iterator(p->log.end()));
+
+	Release(parent);
+}
+
+template <class T>
+void LoggedVersioned<T>::Fold(std::shared_ptr<Revision> main, std::shared_ptr<Segment> parent, std::shared_ptr<Segment> child) {
+	/* child may be shared with running forks, which read it in Get */
+	std::lock_guard<std::mutex> lock(mutex);
+	auto p = versions.find(parent->version);
+	if (p == versions.end())
+		return;
+
+	auto c = versions.find(child->version);
+	if (c == versions.end()) {
+		/* node keeps its address, so does the value */
+		auto node = versions.extract(p);
+		node.key() = child->version;
+		versions.insert(std::move(node));
+		child->written.insert(this);
+		Stats::Fold();
+		return;
+	}
+
+	/* value of child, if any, stays where Get may have returned it */
+	Entry& cur = c->second;
+	if (!cur.value && p->second.value) {
+		cur.value = std::move(p->second.value);
+		for (auto& op: cur.log)
+			op(*cur.value);
+	}
+	cur.log.insert(cur.log.begin(), std::make_move_iterator(p->second.log.begin()),
+		std::make_move_iterator(p->second.log.end()));
+
+	versions.erase(p);
+	Stats::Released();
+}
+
+template <class T>
+bool LoggedVersioned<T>::Merge(std::shared_ptr<Revision> main, std::shared_ptr<Revision> joinRev, std::shared_ptr<Segment> join) {
+	std::vector<const Entry*> logs;
+	std::shared_ptr<Segment> s = joinRev->current;
+	std::shared_ptr<Segment> oldest;
+
+	while (s != joinRev->root) {
+		if (const Entry* e = Find(s->version)) {
+			logs.push_back(e);
+			oldest = s;
+		}
+		s = s->parent;
+	}
+
+	/* whole log of joinRev is replayed once, when its oldest Segment is joined */
+	if (oldest != join)
+		return false;
+
+	Stats::MergeTimer<LoggedVersioned> timer;
+	bool logged = false;
+	for (auto e = logs.rbegin(); e != logs.rend(); ++e) {
+		for (auto& op: (*e)->log) {
+			Apply(main, op);
+			logged = true;
+		}
+	}
+	return logged;
+}
+
+#endif
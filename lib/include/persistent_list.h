@@ -0,0 +1,99 @@
+#ifndef _VS_PERSISTENT_LIST_H
+#define _VS_PERSISTENT_LIST_H
+
+#include <atomic>
+#include <memory>
+
+namespace vs
+{
+	/* internal class */
+
+	/**
+	 * @brief Node of an immutable singly-linked list with shared tails
+	 *
+	 * Many lists can end with the same nodes, so a node is only
+	 * relinked when its slot is the only owner (see own_next()).
+	 */
+	template<typename _Key>
+	struct _plist_node
+	{
+		public:
+
+		typedef std::shared_ptr<_plist_node<_Key>> _Ptr_type;
+
+		_Key value;
+		_Ptr_type next = nullptr;
+
+		/* ------------------ Constructors ----------------------*/
+
+		_plist_node(const _Key& _value, _Ptr_type _next)
+		: value(_value), next(std::move(_next)) { }
+
+		_plist_node(_Key&& _value, _Ptr_type _next)
+		: value(std::move(_value)), next(std::move(_next)) { }
+
+		/**
+		 * @brief unlink the unshared part of the tail iteratively
+		 *
+		 * Default destructor would recurse once per node, and queues
+		 * easily grow deeper than the stack.
+		 */
+		~_plist_node()
+		{
+			_Ptr_type node = std::move(next);
+			while (node && unique(node))
+				node = std::move(node->next);
+		}
+
+		/**
+		 * @brief check that node in slot has no other owners
+		 */
+		static bool
+		unique(const _Ptr_type& node)
+		{
+			if (node.use_count() > 1)
+				return false;
+
+			std::atomic_thread_fence(std::memory_order_acquire);
+			return true;
+		}
+
+		/**
+		 * @brief reverse list, reusing nodes nobody else shares
+		 *
+		 * @param node list to reverse, emptied on return
+		 * @param last set to the node that ends the reversed list
+		 * @return reversed list
+		 */
+		static _Ptr_type
+		reverse(_Ptr_type node, _plist_node*& last)
+		{
+			_Ptr_type res = nullptr;
+			bool shared = false;
+			last = node.get();
+
+			while (node)
+			{
+				shared = shared || !unique(node);
+				if (shared)
+				{
+					res = std::make_shared<_plist_node>(node->value, std::move(res));
+					if (!res->next)
+						last = res.get();
+					node = node->next;
+				}
+				else
+				{
+					_Ptr_type tail = std::move(node->next);
+					node->next = std::move(res);
+					res = std::move(node);
+					node = std::move(tail);
+				}
+			}
+
+			return res;
+		}
+	};
+}
+
+#endif
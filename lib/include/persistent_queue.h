@@ -0,0 +1,144 @@
+#ifndef _VS_PERSISTENT_QUEUE_H
+#define _VS_PERSISTENT_QUEUE_H
+
+#include <cstddef>
+#include <initializer_list>
+#include <utility>
+
+#include "persistent_list.h"
+
+namespace vs
+{
+	/**
+	 * @brief std::queue-like banker's queue over shared immutable lists
+	 *
+	 * Elements live in two lists: front in pop order and rear in reverse
+	 * push order. Copy is O(1) and copies share both lists, push and pop
+	 * are amortized O(1). When front runs out, rear is reversed into it,
+	 * nodes that are not shared with other copies are relinked in place.
+	 *
+	 *  @param _Key  Type of key objects.
+	 */
+	template<typename _Key>
+	class persistent_queue
+	{
+		public:
+
+		/* public typedefs */
+		typedef _Key value_type;
+		typedef _Key& reference;
+		typedef const _Key& const_reference;
+		typedef std::size_t size_type;
+
+		private:
+
+		typedef _plist_node<_Key> _Node_type;
+		typedef _Node_type::_Ptr_type _Ptr_type;
+
+		_Ptr_type _front = nullptr;
+		_Ptr_type _rear = nullptr;
+		/* last pushed element, owned by one of the lists */
+		_Node_type* _back = nullptr;
+		size_type _size = 0;
+
+		public:
+
+		/* ------------------ Constructors ----------------------*/
+
+		persistent_queue() = default;
+
+		persistent_queue(std::initializer_list<_Key> __l)
+		{
+			for (auto& i: __l)
+				push(i);
+		}
+
+		/**
+		 * @brief shares all elements with __queue
+		 */
+		persistent_queue(const persistent_queue& __queue) = default;
+
+		persistent_queue&
+		operator=(const persistent_queue& __queue) = default;
+
+		/**
+		 * @brief takes all elements of __queue, leaving it empty
+		 */
+		persistent_queue(persistent_queue&& __queue) noexcept
+		: _front(std::move(__queue._front)), _rear(std::move(__queue._rear)),
+		  _back(std::exchange(__queue._back, nullptr)), _size(std::exchange(__queue._size, 0)) { }
+
+		persistent_queue&
+		operator=(persistent_queue&& __queue) noexcept
+		{
+			_front = std::move(__queue._front);
+			_rear = std::move(__queue._rear);
+			_back = std::exchange(__queue._back, nullptr);
+			_size = std::exchange(__queue._size, 0);
+			return *this;
+		}
+
+		/* ------------------ Accessors ----------------------*/
+
+		const _Key&
+		front() const
+		{ return _front->value; }
+
+		const _Key&
+		back() const
+		{ return _back->value; }
+
+		size_type
+		size() const noexcept
+		{ return _size; }
+
+		bool
+		empty() const noexcept
+		{ return _size == 0; }
+
+		/* ------------------ Operators ----------------------*/
+
+		void
+		push(const _Key& __x)
+		{ push(_Key(__x)); }
+
+		void
+		push(_Key&& __x)
+		{
+			/* front is never empty while queue is not */
+			if (_front)
+			{
+				_rear = std::make_shared<_Node_type>(std::move(__x), std::move(_rear));
+				_back = _rear.get();
+			}
+			else
+			{
+				_front = std::make_shared<_Node_type>(std::move(__x), nullptr);
+				_back = _front.get();
+			}
+			_size++;
+		}
+
+		template<typename... _Args>
+		void
+		emplace(_Args&&... __args)
+		{ push(_Key(std::forward<_Args>(__args)...)); }
+
+		void
+		pop()
+		{
+			_front = _front->next;
+			_size--;
+
+			if (!_front)
+			{
+				_Node_type* last = nullptr;
+				_front = _Node_type::reverse(std::move(_rear), last);
+				_rear = nullptr;
+				_back = last;
+			}
+		}
+	};
+}
+
+#endif
@@ -0,0 +1,426 @@
+#ifndef _VS_PERSISTENT_SET_H
+#define _VS_PERSISTENT_SET_H
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#include "vs_tree_node.h"
+
+namespace vs
+{
+	template<typename _Key, typename _Comp = std::less<_Key>>
+	class persistent_set;
+
+	/**
+	 * @brief in-order iterator over persistent_set
+	 *
+	 * Shared nodes can't point to their parents, so iterator keeps
+	 * the whole path from the root to the current node.
+	 */
+	template<typename _Key, typename _Comp = std::less<_Key>>
+	struct _pset_iterator
+	{
+		public:
+
+		typedef _vs_tree_node<_Key, _Comp>::_Raw_ptr_type _Ptr_type;
+
+		typedef _Key        value_type;
+		typedef const _Key& reference;
+		typedef const _Key* pointer;
+
+		typedef std::bidirectional_iterator_tag iterator_category;
+		typedef ptrdiff_t                  difference_type;
+
+		typedef _pset_iterator<_Key, _Comp> _Self;
+
+		_pset_iterator()
+		: root(), path() { }
+
+		explicit
+		_pset_iterator(_Ptr_type __root)
+		: root(__root), path() { }
+
+		reference
+		operator*() const
+		{ return path.back()->value; }
+
+		pointer
+		operator->() const
+		{ return &(path.back()->value); }
+
+		/* ------------------ Post/Pre-increment ----------------------*/
+		_Self&
+		operator++()
+		{
+			step(&_Node::right, &_Node::left);
+			return *this;
+		}
+
+		_Self
+		operator++(int)
+		{
+			_Self __tmp = *this;
+			step(&_Node::right, &_Node::left);
+			return __tmp;
+		}
+
+		_Self&
+		operator--()
+		{
+			if (path.empty())
+				descend(root, &_Node::right);
+			else
+				step(&_Node::left, &_Node::right);
+			return *this;
+		}
+
+		_Self
+		operator--(int)
+		{
+			_Self __tmp = *this;
+			--*this;
+			return __tmp;
+		}
+
+		friend bool
+		operator==(const _Self& __x, const _Self& __y)
+		{ return __x.current() == __y.current(); }
+
+		friend bool
+		operator!=(const _Self& __x, const _Self& __y)
+		{ return __x.current() != __y.current(); }
+
+		private:
+
+		friend class persistent_set<_Key, _Comp>;
+
+		typedef _vs_tree_node<_Key, _Comp> _Node;
+		typedef typename _Node::_Ptr_type _Node::* _Child;
+
+		_Ptr_type root;
+		std::vector<_Ptr_type> path;
+
+		_Ptr_type
+		current() const
+		{ return path.empty() ? nullptr : path.back(); }
+
+		/**
+		 * @brief push node and then follow only one side down from it
+		 */
+		void
+		descend(_Ptr_type node, _Child side)
+		{
+			while (node)
+			{
+				path.push_back(node);
+				node = (node->*side).get();
+			}
+		}
+
+		/**
+		 * @brief in-order step, mirrored for decrement
+		 *
+		 * Go once to `forth` and then all the way to `back`, or climb
+		 * up until we come from the `back` side.
+		 */
+		void
+		step(_Child forth, _Child back)
+		{
+			_Ptr_type node = path.back();
+
+			if (node->*forth)
+			{
+				descend((node->*forth).get(), back);
+				return;
+			}
+
+			path.pop_back();
+			while (!path.empty() && (path.back()->*forth).get() == node)
+			{
+				node = path.back();
+				path.pop_back();
+			}
+		}
+	};
+
+	/**
+	 * @brief std::set-like ordered set with structurally shared nodes
+	 *
+	 * Copy is O(1), and an insert into a copy creates only O(log n) new
+	 * nodes, every untouched subtree stays shared with other copies.
+	 * Suitable as a backend for vs_set, where each version would be
+	 * a full std::set otherwise.
+	 *
+	 *  @param _Key  Type of key objects.
+	 *  @param _Comp  Comparison function object type, defaults to less<_Key>.
+	 */
+	template<typename _Key, typename _Comp>
+	class persistent_set
+	{
+		public:
+
+		/* public typedefs */
+		typedef _Key key_type;
+		typedef _Key value_type;
+		typedef _Comp key_compare;
+		typedef _pset_iterator<_Key, _Comp> iterator;
+		typedef _pset_iterator<_Key, _Comp> const_iterator;
+		typedef std::size_t size_type;
+
+		private:
+
+		typedef _vs_tree_node<_Key, _Comp> _Node_type;
+		typedef _Node_type::_Ptr_type _Ptr_type;
+
+		_Ptr_type root = nullptr;
+		size_type _size = 0;
+		_Comp comp;
+
+		public:
+
+		/* ------------------ Constructors ----------------------*/
+
+		explicit
+		persistent_set(const _Comp& __comp = _Comp())
+		: comp(__comp) { }
+
+		persistent_set(std::initializer_list<_Key> __l,
+			const _Comp& __comp = _Comp())
+		: comp(__comp)
+		{
+			for (auto& i: __l)
+				insert(i);
+		}
+
+		template<typename _InputIterator>
+		persistent_set(_InputIterator __first, _InputIterator __last,
+			const _Comp& __comp = _Comp())
+		: comp(__comp)
+		{ insert(__first, __last); }
+
+		/**
+		 * @brief shares all nodes with __set
+		 */
+		persistent_set(const persistent_set& __set) = default;
+
+		persistent_set&
+		operator=(const persistent_set& __set) = default;
+
+		/**
+		 * @brief takes all nodes of __set, leaving it empty
+		 */
+		persistent_set(persistent_set&& __set) noexcept
+		: root(std::move(__set.root)), _size(std::exchange(__set._size, 0)),
+		  comp(__set.comp) { }
+
+		persistent_set&
+		operator=(persistent_set&& __set) noexcept
+		{
+			root = std::move(__set.root);
+			_size = std::exchange(__set._size, 0);
+			comp = __set.comp;
+			return *this;
+		}
+
+		/* ------------------ Accessors ----------------------*/
+
+		iterator
+		begin() const
+		{
+			iterator it(root.get());
+			it.descend(root.get(), &_Node_type::left);
+			return it;
+		}
+
+		iterator
+		end() const
+		{ return iterator(root.get()); }
+
+		size_type
+		size() const noexcept
+		{ return _size; }
+
+		bool
+		empty() const noexcept
+		{ return _size == 0; }
+
+		bool
+		contains(const _Key& __x) const
+		{ return find(__x) != end(); }
+
+		/**
+		 * @brief find element without touching any node
+		 */
+		iterator
+		find(const _Key& __x) const
+		{
+			iterator it(root.get());
+			typename _Node_type::_Raw_ptr_type node = root.get();
+
+			while (node)
+			{
+				it.path.push_back(node);
+				if (comp(__x, node->value))
+					node = node->left.get();
+				else if (comp(node->value, __x))
+					node = node->right.get();
+				else
+					return it;
+			}
+
+			return end();
+		}
+
+		/**
+		 * @brief find element to modify in place
+		 *
+		 * Copies shared nodes on the path to found element, so writing
+		 * through the iterator (as merge strategies do) is not visible in
+		 * other copies of the set.
+		 */
+		iterator
+		find(const _Key& __x)
+		{
+			if (std::as_const(*this).find(__x) == end())
+				return end();
+
+			iterator it(nullptr);
+			_Ptr_type* slot = &root;
+
+			while (true)
+			{
+				_Ptr_type& node = _Node_type::own(*slot);
+				it.path.push_back(node.get());
+
+				if (comp(__x, node->value))
+					slot = &node->left;
+				else if (comp(node->value, __x))
+					slot = &node->right;
+				else
+					break;
+			}
+
+			it.root = root.get();
+			return it;
+		}
+
+		/* ------------------ Operators ----------------------*/
+
+		/**
+		 * @brief Attempts to insert an element into the set.
+		 * @return pair of iterator to element and true if it was inserted
+		 */
+		std::pair<iterator, bool>
+		insert(const _Key& __x)
+		{ return insert_unique(__x); }
+
+		/**
+		 * @brief Attempts to move an element into the set.
+		 *
+		 * Element is left untouched if it is already present.
+		 */
+		std::pair<iterator, bool>
+		insert(_Key&& __x)
+		{ return insert_unique(std::move(__x)); }
+
+		/**
+		 * @brief Attempts to insert an element built from __args.
+		 */
+		template<typename... _Args>
+		std::pair<iterator, bool>
+		emplace(_Args&&... __args)
+		{ return insert_unique(_Key(std::forward<_Args>(__args)...)); }
+
+		/**
+		 * @brief Inserts elements of a range into the set.
+		 *
+		 * Strictly sorted range that is not smaller than the set is merged
+		 * with it and built anew in linear time, instead of log time per
+		 * element. Nodes of the set are not shared then with its copies.
+		 */
+		template<typename _InputIterator>
+		void
+		insert(_InputIterator __first, _InputIterator __last)
+		{
+			std::vector<_Key> values(__first, __last);
+			auto not_less = [this](const _Key& a, const _Key& b) { return !comp(a, b); };
+
+			if (values.size() < _size ||
+				std::adjacent_find(values.begin(), values.end(), not_less) != values.end())
+			{
+				for (auto& i: values)
+					insert(i);
+				return;
+			}
+
+			if (_size)
+			{
+				std::vector<_Key> old;
+				old.reserve(_size);
+				_Node_type::collect_sorted(root.get(), old);
+
+				std::vector<_Key> all;
+				all.reserve(old.size() + values.size());
+				std::set_union(old.begin(), old.end(), values.begin(), values.end(),
+					std::back_inserter(all), comp);
+				values = std::move(all);
+			}
+
+			auto it = values.cbegin();
+			root = _Node_type::build_sorted(it, values.size());
+			_size = values.size();
+		}
+
+		private:
+
+		template<typename _Arg>
+		std::pair<iterator, bool>
+		insert_unique(_Arg&& __x)
+		{
+			iterator found = std::as_const(*this).find(__x);
+			if (found != end())
+				return {found, false};
+
+			/* new leaf is not shared, so rebalancing does not copy it */
+			_Node_type* node = node_insert_unique(root, std::forward<_Arg>(__x));
+			_size++;
+
+			return {std::as_const(*this).find(node->value), true};
+		}
+
+		/**
+		 * @brief same descent as _vs_tree_node::node_insert, but element
+		 * is known to be absent
+		 *
+		 * @return created node
+		 */
+		template<typename _Arg>
+		_Node_type*
+		node_insert_unique(_Ptr_type& node, _Arg&& __x)
+		{
+			if (!node)
+			{
+				node = _Node_type::create(std::forward<_Arg>(__x));
+				return node.get();
+			}
+
+			_Node_type::own(node);
+
+			_Node_type* res;
+			if (comp(__x, node->value))
+				res = node_insert_unique(node->left, std::forward<_Arg>(__x));
+			else
+				res = node_insert_unique(node->right, std::forward<_Arg>(__x));
+
+			_Node_type::rebalance(node);
+			return res;
+		}
+	};
+}
+
+#endif
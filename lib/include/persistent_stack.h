@@ -0,0 +1,153 @@
+#ifndef _VS_PERSISTENT_STACK_H
+#define _VS_PERSISTENT_STACK_H
+
+#include <cstddef>
+#include <initializer_list>
+#include <utility>
+#include <vector>
+
+#include "persistent_list.h"
+
+namespace vs
+{
+	/**
+	 * @brief std::stack-like stack over a shared immutable list
+	 *
+	 * Copy is O(1), copies share all frames below their own pushes,
+	 * push and pop are O(1).
+	 *
+	 *  @param _Key  Type of key objects.
+	 */
+	template<typename _Key>
+	class persistent_stack
+	{
+		public:
+
+		/* public typedefs */
+		typedef _Key value_type;
+		typedef _Key& reference;
+		typedef const _Key& const_reference;
+		typedef std::size_t size_type;
+
+		private:
+
+		typedef _plist_node<_Key> _Node_type;
+		typedef _Node_type::_Ptr_type _Ptr_type;
+
+		_Ptr_type _top = nullptr;
+		size_type _size = 0;
+
+		public:
+
+		/* ------------------ Constructors ----------------------*/
+
+		persistent_stack() = default;
+
+		persistent_stack(std::initializer_list<_Key> __l)
+		{
+			for (auto& i: __l)
+				push(i);
+		}
+
+		/**
+		 * @brief shares all frames with __stack
+		 */
+		persistent_stack(const persistent_stack& __stack) = default;
+
+		persistent_stack&
+		operator=(const persistent_stack& __stack) = default;
+
+		/**
+		 * @brief takes all frames of __stack, leaving it empty
+		 */
+		persistent_stack(persistent_stack&& __stack) noexcept
+		: _top(std::move(__stack._top)), _size(std::exchange(__stack._size, 0)) { }
+
+		persistent_stack&
+		operator=(persistent_stack&& __stack) noexcept
+		{
+			_top = std::move(__stack._top);
+			_size = std::exchange(__stack._size, 0);
+			return *this;
+		}
+
+		/* ------------------ Accessors ----------------------*/
+
+		const _Key&
+		top() const
+		{ return _top->value; }
+
+		size_type
+		size() const noexcept
+		{ return _size; }
+
+		bool
+		empty() const noexcept
+		{ return _size == 0; }
+
+		/* ------------------ Operators ----------------------*/
+
+		void
+		push(const _Key& __x)
+		{
+			_top = std::make_shared<_Node_type>(__x, std::move(_top));
+			_size++;
+		}
+
+		void
+		push(_Key&& __x)
+		{
+			_top = std::make_shared<_Node_type>(std::move(__x), std::move(_top));
+			_size++;
+		}
+
+		template<typename... _Args>
+		void
+		emplace(_Args&&... __args)
+		{ push(_Key(std::forward<_Args>(__args)...)); }
+
+		void
+		pop()
+		{
+			_top = _top->next;
+			_size--;
+		}
+
+		/**
+		 * @brief push frames that __src has above the tail shared with us
+		 *
+		 * Both stacks are walked down only to their common tail, so the
+		 * cost is the number of frames pushed after they were forked
+		 * from each other, not their size. Frames that __src popped from
+		 * the common part are not removed here.
+		 */
+		void
+		splice(const persistent_stack& __src)
+		{
+			_Node_type* a = _top.get();
+			_Node_type* b = __src._top.get();
+			size_type asz = _size;
+			size_type bsz = __src._size;
+			std::vector<_Node_type*> frames;
+
+			for (; bsz > asz; bsz--, b = b->next.get())
+				frames.push_back(b);
+			for (; asz > bsz; asz--)
+				a = a->next.get();
+			for (; a != b; a = a->next.get(), b = b->next.get())
+				frames.push_back(b);
+
+			/* we did not change anything since fork, just take __src */
+			if (a == _top.get())
+			{
+				*this = __src;
+				return;
+			}
+
+			for (auto it = frames.rbegin(); it != frames.rend(); ++it)
+				push((*it)->value);
+		}
+	};
+}
+
+#endif
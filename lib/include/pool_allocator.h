@@ -0,0 +1,213 @@
+/**
+ * @file  pool_allocator.h
+ *
+ * @brief Implementation of the FixedPool and PoolAllocator classes.
+ */
+
+#ifndef __POOL_ALLOCATOR_H__
+#define __POOL_ALLOCATOR_H__
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+
+/**
+ * @brief Recycling pool of equally sized blocks
+ *
+ * Every thread keeps its own list of free blocks, so allocation and
+ * deallocation are a couple of pointer moves without any locks. Threads
+ * that free more than they allocate (joining threads free what forks
+ * allocated) hand surplus to a shared list, and take from it before
+ * asking the heap for a new chunk. Chunks are never returned to the heap.
+ *
+ * @tparam Size Block size
+ * @tparam Align Block alignment
+ */
+template <std::size_t Size, std::size_t Align>
+class FixedPool
+{
+public:
+	/**
+	 * @brief Take a block
+	 *
+	 */
+	static void* allocate();
+
+	/**
+	 * @brief Return a block, it can come from any thread
+	 *
+	 */
+	static void deallocate(void* p) noexcept;
+
+private:
+	struct Node {
+		Node* next;
+	};
+
+	static constexpr std::size_t align = std::max(Align, alignof(Node));
+	static constexpr std::size_t block_size = (std::max(Size, sizeof(Node)) + align - 1) / align * align;
+	static constexpr std::size_t chunk_blocks = 64;
+	/* free blocks a thread keeps before giving half of them away */
+	static constexpr std::size_t local_limit = 4 * chunk_blocks;
+
+	/* trivially destructible, so it is usable even during thread exit */
+	struct Local {
+		Node* head = nullptr;
+		std::size_t count = 0;
+		bool dead = false;
+	};
+
+	/* gives free blocks of exited thread to others */
+	struct Flusher {
+		~Flusher();
+	};
+
+	/**
+	 * @brief Move n blocks from the head of local list to the shared one
+	 */
+	static void GiveAway(std::size_t n) noexcept;
+
+	/**
+	 * @brief Refill local list from the shared one or from a new chunk
+	 */
+	static void Refill();
+
+	inline static thread_local Local local;
+	inline static thread_local Flusher flusher;
+
+	inline static std::mutex shared_mutex;
+	inline static Node* shared_head = nullptr;
+	inline static std::size_t shared_count = 0;
+};
+
+/**
+ * @brief Standard allocator on top of FixedPool
+ *
+ * Single objects come from the pool of their size, arrays go to the heap.
+ * Use it with std::allocate_shared to pool the object together with its
+ * control block.
+ *
+ * @tparam T Allocated type
+ */
+template <class T>
+class PoolAllocator
+{
+public:
+	typedef T value_type;
+
+	PoolAllocator() noexcept = default;
+
+	template <class U>
+	PoolAllocator(const PoolAllocator<U>&) noexcept {}
+
+	T* allocate(std::size_t n) {
+		if (n == 1)
+			return static_cast<T*>(FixedPool<sizeof(T), alignof(T)>::allocate());
+		return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(alignof(T))));
+	}
+
+	void deallocate(T* p, std::size_t n) noexcept {
+		if (n == 1)
+			FixedPool<sizeof(T), alignof(T)>::deallocate(p);
+		else
+			::operator delete(p, std::align_val_t(alignof(T)));
+	}
+
+	template <class U>
+	friend bool operator==(const PoolAllocator&, const PoolAllocator<U>&) noexcept { return true; }
+};
+
+/**
+ * @brief Like std::make_shared, but object and control block are pooled
+ *
+ */
+template <class T, class... Args>
+std::shared_ptr<T> MakePooled(Args&&... args) {
+	return std::allocate_shared<T>(PoolAllocator<T>(), std::forward<Args>(args)...);
+}
+
+
+template <std::size_t Size, std::size_t Align>
+void* FixedPool<Size,Align>::allocate() {
+	(void)&flusher;
+
+	if (!local.head)
+		Refill();
+
+	Node* n = local.head;
+	local.head = n->next;
+	local.count--;
+	return n;
+}
+
+template <std::size_t Size, std::size_t Align>
+void FixedPool<Size,Align>::deallocate(void* p) noexcept {
+	/* threads that only free blocks must give them back on exit too */
+	(void)&flusher;
+
+	Node* n = static_cast<Node*>(p);
+	n->next = local.head;
+	local.head = n;
+	local.count++;
+
+	if (local.dead)
+		GiveAway(local.count);
+	else if (local.count > local_limit)
+		GiveAway(local.count / 2);
+}
+
+template <std::size_t Size, std::size_t Align>
+void FixedPool<Size,Align>::GiveAway(std::size_t n) noexcept {
+	if (n == 0)
+		return;
+
+	Node* first = local.head;
+	Node* last = first;
+	for (std::size_t i = 1; i < n; i++)
+		last = last->next;
+
+	local.head = last->next;
+	local.count -= n;
+
+	std::lock_guard<std::mutex> lock(shared_mutex);
+	last->next = shared_head;
+	shared_head = first;
+	shared_count += n;
+}
+
+template <std::size_t Size, std::size_t Align>
+void FixedPool<Size,Align>::Refill() {
+	{
+		std::lock_guard<std::mutex> lock(shared_mutex);
+		std::size_t n = std::min(shared_count, chunk_blocks);
+		for (std::size_t i = 0; i < n; i++) {
+			Node* node = shared_head;
+			shared_head = node->next;
+			node->next = local.head;
+			local.head = node;
+		}
+		shared_count -= n;
+		local.count += n;
+	}
+	if (local.head)
+		return;
+
+	char* chunk = static_cast<char*>(::operator new(block_size * chunk_blocks, std::align_val_t(align)));
+	for (std::size_t i = chunk_blocks; i-- > 0;) {
+		Node* node = reinterpret_cast<Node*>(chunk + i * block_size);
+		node->next = local.head;
+		local.head = node;
+	}
+	local.count += chunk_blocks;
+}
+
+template <std::size_t Size, std::size_t Align>
+FixedPool<Size,Align>::Flusher::~Flusher() {
+	GiveAway(local.count);
+	local.dead = true;
+}
+
+#endif
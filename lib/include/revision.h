@@ -11,8 +11,66 @@
 #include <memory>
 #include <iostream>
 #include <functional>
+#include <cstddef>
+#include <cstdint>
+#include "segment.h"
 
-class Segment;
+/**
+ * @brief Direct-mapped cache of values resolved by Versioned::Get
+ *
+ * Get looks up the nearest version in Segment chain on every call, but
+ * the answer changes only when the variable is written in the current
+ * Segment or the chain is collapsed. Entries are keyed by variable id and
+ * current Segment version, so moving to a new Segment invalidates them
+ * all at once. Each Revision is used by one thread, so no locks needed.
+ */
+class ReadCache
+{
+public:
+	/**
+	 * @brief Number of entries, must be a power of two
+	 *
+	 */
+	static constexpr std::size_t size = 64;
+
+	/**
+	 * @brief Find value resolved for variable in Segment
+	 *
+	 * @param var Variable id
+	 * @param segment Current Segment version
+	 * @return const void* Resolved value or nullptr
+	 */
+	const void* find(std::uint64_t var, Segment::version_type segment) const {
+		const Entry& e = entries[var & (size - 1)];
+		return (e.var == var && e.segment == segment) ? e.value : nullptr;
+	}
+
+	/**
+	 * @brief Remember value resolved for variable in Segment
+	 */
+	void store(std::uint64_t var, Segment::version_type segment, const void* value) {
+		entries[var & (size - 1)] = {var, segment, value};
+	}
+
+	/**
+	 * @brief Forget value of variable, must be called when it is written
+	 */
+	void invalidate(std::uint64_t var) {
+		Entry& e = entries[var & (size - 1)];
+		if (e.var == var)
+			e.var = 0;
+	}
+
+private:
+	struct Entry {
+		/* variable ids start from 1, so 0 is never matched */
+		std::uint64_t var = 0;
+		Segment::version_type segment = 0;
+		const void* value = nullptr;
+	};
+
+	Entry entries[size];
+};
 
 /**
  * @brief Revision class for for keeping track of segment branches
@@ -56,6 +114,20 @@ public:
 	 */
 	std::thread thread;
 
+	/**
+	 * @brief Values resolved by Versioned::Get in this Revision
+	 *
+	 * @see ReadCache
+	 */
+	ReadCache cache;
+
+	/**
+	 * @brief Depth of current Segment when the chain was last compacted
+	 *
+	 * @see CompactRevision
+	 */
+	Segment::depth_type compactedDepth;
+
 	/**
 	 * @brief The current Revision for current thread
 	 *
@@ -65,10 +137,129 @@ public:
 	thread_local static std::shared_ptr<Revision> currentRevision;
 };
 
+/**
+ * @brief Fork new Revision from the current Revision of this thread
+ *
+ * Current Revision moves to a new Segment, so its further changes are
+ * not visible in the forked one.
+ *
+ * @return std::shared_ptr<Revision> Revision to run the forked work in
+ */
+std::shared_ptr<Revision> ForkRevision();
+
+/**
+ * @brief Fork new Revision from the same Segment as its sibling
+ *
+ * If current Revision hasn't written anything since the sibling was
+ * forked, the new Revision starts where the sibling did, so forking a
+ * group doesn't put a Segment per fork on the chain. Otherwise it is the
+ * same as ForkRevision().
+ *
+ * @param sibling Revision forked before from the current one
+ * @return std::shared_ptr<Revision> Revision to run the forked work in
+ */
+std::shared_ptr<Revision> ForkRevision(const Revision& sibling);
+
+/**
+ * @brief Freeze state of the current Revision of this thread
+ *
+ * Returns the Segment that holds the current state, with a reference
+ * taken for the caller. Versions visible from it are not changed or
+ * freed until the caller calls Release on it, from any thread. Current
+ * Revision moves to a new Segment if it wrote something since the last
+ * fork, so its further changes go there.
+ *
+ * @return std::shared_ptr<Segment> Pinned Segment
+ */
+std::shared_ptr<Segment> PinRevision();
+
+/**
+ * @brief Merge finished Revision into the current Revision of this thread
+ *
+ * Must be called from the Revision it was forked from, after all work
+ * in the joined Revision is done.
+ *
+ * @param joinRev Revision returned by ForkRevision
+ */
+void JoinRevision(std::shared_ptr<Revision> joinRev);
+
+/**
+ * @brief Merge finished Revision into the given one
+ *
+ * Same as JoinRevision(joinRev) called in main. Used to merge siblings
+ * forked from the same Revision into each other before merging the
+ * result into their parent.
+ *
+ * @param main Revision to merge into, not used by other threads meanwhile
+ * @param joinRev Revision forked from main or from the same Segment
+ */
+void JoinRevision(const std::shared_ptr<Revision>& main, std::shared_ptr<Revision> joinRev);
+
+/**
+ * @brief Set smallest number of written variables merged in parallel
+ *
+ * JoinRevision splits variables written in the joined Revision between
+ * workers of vs::WorkerPool when there are at least that many of them.
+ * Smaller joins are merged by the joining thread alone, as handing work
+ * to other threads costs more than merging a few variables. SIZE_MAX
+ * makes every join serial.
+ *
+ * @param cutoff Number of written variables, 4096 by default
+ */
+void SetParallelMergeCutoff(std::size_t cutoff);
+
+/**
+ * @brief Get current cutoff of parallel merge
+ *
+ * @see SetParallelMergeCutoff
+ */
+std::size_t GetParallelMergeCutoff();
+
+/**
+ * @brief Set chain length after which forks compact the chain
+ *
+ * Segments of a Revision are collapsed only on join, and only up to
+ * the first one still shared with a running fork. A Revision that keeps
+ * forking while some forks run piles up Segments behind it. So once the
+ * chain has grown by that many Segments since the last compaction,
+ * ForkRevision calls CompactRevision with twice that budget.
+ *
+ * @param length Number of Segments, 64 by default, 0 turns it off
+ */
+void SetCompactionLength(std::size_t length);
+
+/**
+ * @brief Get current chain length of compaction
+ *
+ * @see SetCompactionLength
+ */
+std::size_t GetCompactionLength();
+
+/**
+ * @brief Fold unshared Segments of the chain into their children
+ *
+ * Walks up from the current Segment and moves versions of each Segment
+ * that no one else references into its child, so variables keep at
+ * most one version per Segment still shared with forks. Work is bounded
+ * by the number of Segments visited. Must be called by the thread that
+ * uses main.
+ *
+ * @param main Revision whose chain is compacted
+ * @param budget Most Segments to visit
+ * @return std::size_t Number of folded Segments
+ */
+std::size_t CompactRevision(const std::shared_ptr<Revision>& main, std::size_t budget);
+
 /**
  * @brief Print revision segments for debugging
  *
+ * Library never prints on its own, trace events are the way to watch
+ * Revisions at runtime.
+ *
+ * @param revision Revision to print
+ * @param out Stream to print to, std::cerr by default
+ * @see Trace
  */
-void PrintRevision(std::shared_ptr<Revision> revision);
+void PrintRevision(std::shared_ptr<Revision> revision, std::ostream& out = std::cerr);
 
 #endif
\ No newline at end of file
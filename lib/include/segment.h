@@ -7,8 +7,10 @@
 #ifndef __SEGMENT_H__
 #define __SEGMENT_H__
 
-#include <list>
+#include <atomic>
+#include <cstdint>
 #include <memory>
+#include "write_set.h"
 
 class Revision;
 class VersionedI;
@@ -20,6 +22,18 @@ class VersionedI;
 class Segment : public std::enable_shared_from_this<Segment>
 {
 public:
+	/**
+	 * @brief Type of Segment version numbers
+	 *
+	 */
+	typedef std::uint64_t version_type;
+
+	/**
+	 * @brief Type of Segment depth in its chain
+	 *
+	 */
+	typedef int depth_type;
+
 	/**
 	 * @brief Construct the very first Segment
 	 *
@@ -47,6 +61,40 @@ public:
 	 */
 	void Collapse(std::shared_ptr<Revision> main);
 
+	/**
+	 * @brief Move versions of parent Segment into that one
+	 *
+	 * Parent must be unshared, so that one is its only child. Parent
+	 * stays in the chain, as other threads may walk through it, but it
+	 * keeps no versions afterwards.
+	 *
+	 * @param main Revision of whose branch that Segment is
+	 * @see Revision
+	 */
+	void FoldParent(std::shared_ptr<Revision> main);
+
+	/**
+	 * @brief Find the deepest ancestor of that Segment not below depth d
+	 *
+	 * Follows jump pointers, so it takes O(log depth) steps.
+	 *
+	 * @param d Depth of ancestor, not greater than own depth
+	 * @return const Segment* Ancestor, or this Segment if d is own depth
+	 */
+	const Segment* Ancestor(depth_type d) const;
+
+	/**
+	 * @brief Check that versions of ancestor are visible only from here
+	 *
+	 * True if that Segment and all its parents up to ancestor have no
+	 * other references, so no other Revision or forked Segment can read
+	 * what they store. Only the owner adds references to its chain, so
+	 * the answer can't change behind its back.
+	 *
+	 * @param ancestor Segment in the chain of that Segment, itself included
+	 */
+	bool Unshared(const Segment* ancestor) const;
+
 	/**
 	 * @brief Previous Segment
 	 *
@@ -57,27 +105,66 @@ public:
 	 * @brief Version of that Segment
 	 *
 	 */
-	int version;
+	version_type version;
+
+	/**
+	 * @brief Position of that Segment in its chain
+	 *
+	 * Number of parents it had when created. It never changes, as other
+	 * threads read it, so after Collapse removes parents there are gaps.
+	 */
+	depth_type depth;
+
+	/**
+	 * @brief Skew-binary jump pointer to one of the ancestors
+	 *
+	 * Jumps are arranged so that any ancestor is reachable in O(log depth)
+	 * steps. It points into parent chain, so the chain keeps it alive, and
+	 * Collapse sets it again. nullptr in the first Segment.
+	 */
+	const Segment* jump;
 
 	/**
 	 * @brief Count of references for that Segment
 	 *
+	 * Changed by forks and joins of different threads, so it is atomic
+	 * and kept in its own cache line, away from the read-mostly fields
+	 * every Get looks at.
 	 */
-	int refcount;
+	alignas(64) std::atomic<int> refcount;
 
 	/**
-	 * @brief List of all Versioned variables that were changed
+	 * @brief Set of all Versioned variables that were changed
 	 *
 	 * @see VersionedI
+	 * @see WriteSet
 	 */
-	std::list<VersionedI*> written;
+	WriteSet written;
 
 private:
 	/**
-	 * @brief Last used Segment version number between all threads
+	 * @brief Set jump pointer from the current parent
+	 *
+	 */
+	void Link();
+
+	/**
+	 * @brief Take next version number from the block of current thread
+	 *
+	 */
+	static version_type NextVersion();
+
+	/**
+	 * @brief How many version numbers a thread takes at once
+	 *
+	 */
+	static constexpr version_type versionBlock = 1024;
+
+	/**
+	 * @brief First version number not yet given to any thread
 	 *
 	 */
-	static int versionCount;
+	alignas(64) static std::atomic<version_type> versionCount;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,377 @@
+/**
+ * @file  stats.h
+ *
+ * @brief Implementation of the runtime statistics of versioning.
+ */
+
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <ranges>
+#include <string>
+#include <typeinfo>
+
+/**
+ * @brief Statistics are recorded only if built with VS_STATS defined
+ *
+ * Otherwise every recording call is an empty inline function, and
+ * exported statistics are all zeros.
+ */
+#ifdef VS_STATS
+inline constexpr bool statsEnabled = true;
+#else
+inline constexpr bool statsEnabled = false;
+#endif
+
+/**
+ * @brief Histogram with power of two buckets
+ *
+ * Bucket 0 counts zeros, bucket i counts values in [2^(i-1), 2^i),
+ * the last one counts everything above.
+ */
+struct StatsHistogram
+{
+	static constexpr std::size_t buckets = 32;
+
+	std::uint64_t counts[buckets] = {};
+	std::uint64_t count = 0;
+	std::uint64_t sum = 0;
+
+	static constexpr std::size_t bucket(std::uint64_t value) {
+		std::size_t b = std::bit_width(value);
+		return b < buckets ? b : buckets - 1;
+	}
+
+	/**
+	 * @brief Upper bound of bucket, exclusive
+	 */
+	static constexpr std::uint64_t bound(std::size_t b) {
+		return std::uint64_t(1) << b;
+	}
+
+	void add(const StatsHistogram& other);
+};
+
+/**
+ * @brief Merge and collapse times of one merge strategy
+ */
+struct StrategyStats
+{
+	/* nanoseconds */
+	StatsHistogram merge;
+	StatsHistogram collapse;
+};
+
+/**
+ * @brief Statistics summed over all threads
+ */
+struct StatsSnapshot
+{
+	/* versions made by copying a value, with estimated size of copies */
+	std::uint64_t copies = 0;
+	std::uint64_t bytesCopied = 0;
+	/* versions made by moving a value */
+	std::uint64_t moves = 0;
+	/* versions created and destroyed, their difference is live versions */
+	std::uint64_t versionsCreated = 0;
+	std::uint64_t versionsReleased = 0;
+	/* versions handed to a child Segment by compaction */
+	std::uint64_t folds = 0;
+	std::uint64_t gets = 0;
+	std::uint64_t cacheHits = 0;
+	std::uint64_t forks = 0;
+	std::uint64_t joins = 0;
+
+	/* Segments between the current one and the version read by Get, on cache misses */
+	StatsHistogram chainWalk;
+	/* versions kept by a variable, sampled when it gets a new one */
+	StatsHistogram versionsPerVariable;
+	/* whole join time in nanoseconds */
+	StatsHistogram joinTime;
+	/* keyed by strategy type name */
+	std::map<std::string, StrategyStats> strategies;
+
+	std::int64_t liveVersions() const {
+		return static_cast<std::int64_t>(versionsCreated - versionsReleased);
+	}
+};
+
+/**
+ * @brief Per-thread counters of versioning work
+ *
+ * Each thread writes only its own block of counters, so recording is a
+ * relaxed load and store without any contention. Blocks of finished
+ * threads are reused by new ones, so totals are never lost. Collecting
+ * reads all blocks, it can be done any time from any thread.
+ */
+class Stats
+{
+public:
+	/* strategies above that share the last slot */
+	static constexpr std::size_t maxStrategies = 32;
+
+	static void Copy(std::size_t bytes) {
+		if constexpr (statsEnabled) {
+			Counters& c = Local();
+			Bump(c, Copies);
+			Bump(c, BytesCopied, bytes);
+		}
+	}
+
+	static void Move() {
+		if constexpr (statsEnabled)
+			Bump(Local(), Moves);
+	}
+
+	/**
+	 * @brief New version, with count of versions the variable has now
+	 */
+	static void Created(std::size_t versions) {
+		if constexpr (statsEnabled) {
+			Counters& c = Local();
+			Bump(c, VersionsCreated);
+			Add(c, VersionsPerVariable, versions);
+		}
+	}
+
+	static void Released(std::size_t versions = 1) {
+		if constexpr (statsEnabled)
+			Bump(Local(), VersionsReleased, versions);
+	}
+
+	static void Fold() {
+		if constexpr (statsEnabled)
+			Bump(Local(), Folds);
+	}
+
+	static void Get(bool cached) {
+		if constexpr (statsEnabled) {
+			Counters& c = Local();
+			Bump(c, Gets);
+			if (cached)
+				Bump(c, CacheHits);
+		}
+	}
+
+	static void ChainWalk(std::uint64_t segments) {
+		if constexpr (statsEnabled)
+			Add(Local(), ChainWalkHist, segments);
+	}
+
+	static void Fork() {
+		if constexpr (statsEnabled)
+			Bump(Local(), Forks);
+	}
+
+	static void Join(std::uint64_t ns) {
+		if constexpr (statsEnabled) {
+			Counters& c = Local();
+			Bump(c, Joins);
+			Add(c, JoinTime, ns);
+		}
+	}
+
+	/**
+	 * @brief Index of strategy in per-strategy statistics
+	 */
+	template <class S>
+	static std::size_t StrategyId() {
+		static const std::size_t id = RegisterStrategy(typeid(S).name());
+		return id;
+	}
+
+	/**
+	 * @brief Time since construction
+	 *
+	 * Clock is not read at all if statistics are disabled.
+	 */
+	class Stopwatch {
+	public:
+		Stopwatch() {
+			if constexpr (statsEnabled)
+				start = std::chrono::steady_clock::now();
+		}
+
+		std::uint64_t elapsed() const {
+			if constexpr (statsEnabled)
+				return std::chrono::duration_cast<std::chrono::nanoseconds>(
+					std::chrono::steady_clock::now() - start).count();
+			else
+				return 0;
+		}
+
+		Stopwatch(const Stopwatch&) = delete;
+		Stopwatch& operator=(const Stopwatch&) = delete;
+
+	private:
+		std::chrono::steady_clock::time_point start;
+	};
+
+	/**
+	 * @brief Measures time of merge or collapse for strategy S
+	 */
+	template <class S, bool IsMerge>
+	class Timer : Stopwatch {
+	public:
+		~Timer() {
+			if constexpr (statsEnabled)
+				StrategyTime(StrategyId<S>(), IsMerge, elapsed());
+		}
+	};
+
+	/**
+	 * @brief Measures time of the whole join
+	 */
+	class JoinTimer : Stopwatch {
+	public:
+		~JoinTimer() {
+			if constexpr (statsEnabled)
+				Join(elapsed());
+		}
+	};
+
+	template <class S>
+	using MergeTimer = Timer<S, true>;
+
+	template <class S>
+	using CollapseTimer = Timer<S, false>;
+
+private:
+	enum Counter {
+		Copies, BytesCopied, Moves, VersionsCreated, VersionsReleased, Folds,
+		Gets, CacheHits, Forks, Joins, CounterCount
+	};
+
+	enum Histogram {
+		ChainWalkHist, VersionsPerVariable, JoinTime, HistogramCount
+	};
+
+	struct Cells {
+		std::atomic<std::uint64_t> counts[StatsHistogram::buckets] = {};
+		std::atomic<std::uint64_t> count = 0;
+		std::atomic<std::uint64_t> sum = 0;
+	};
+
+	struct Counters {
+		std::atomic<std::uint64_t> counters[CounterCount] = {};
+		Cells histograms[HistogramCount];
+		/* merge and collapse of each strategy */
+		Cells strategies[maxStrategies][2];
+		/* block is written by several threads, only the one for exiting threads */
+		bool shared = false;
+		/* block is not used by any thread */
+		Counters* nextFree = nullptr;
+	};
+
+	static Counters& Local() {
+		return local ? *local : Attach();
+	}
+
+	static void Bump(Counters& c, std::atomic<std::uint64_t>& cell, std::uint64_t n) {
+		/* plain load and store are enough for the only writer */
+		if (c.shared)
+			cell.fetch_add(n, std::memory_order_relaxed);
+		else
+			cell.store(cell.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+	}
+
+	static void Bump(Counters& c, Counter counter, std::uint64_t n = 1) {
+		Bump(c, c.counters[counter], n);
+	}
+
+	static void Add(Counters& c, Cells& cells, std::uint64_t value) {
+		Bump(c, cells.counts[StatsHistogram::bucket(value)], 1);
+		Bump(c, cells.count, 1);
+		Bump(c, cells.sum, value);
+	}
+
+	static void Add(Counters& c, Histogram hist, std::uint64_t value) {
+		Add(c, c.histograms[hist], value);
+	}
+
+	static void StrategyTime(std::size_t strategy, bool merge, std::uint64_t ns) {
+		Counters& c = Local();
+		Add(c, c.strategies[strategy][merge ? 0 : 1], ns);
+	}
+
+	/**
+	 * @brief Give this thread a block of counters
+	 */
+	static Counters& Attach();
+
+	/**
+	 * @brief Give block of this thread back, when it exits
+	 */
+	static void Detach();
+
+	/**
+	 * @brief Block shared by exiting threads
+	 */
+	static Counters& Exited();
+
+	friend struct StatsOwner;
+	friend struct StatsRegistry;
+
+	static std::size_t RegisterStrategy(const char* name);
+
+	friend StatsSnapshot CollectStats();
+	friend void ResetStats();
+
+	/* block of the thread, trivially destructible, so usable during thread exit */
+	thread_local static Counters* local;
+};
+
+/**
+ * @brief Estimated size of a copied value
+ *
+ * Size of the object itself, plus size of its elements if it is a
+ * sized range. Nodes and other indirections are not counted.
+ */
+template <class T>
+std::size_t StatsBytes(const T& value) {
+	if constexpr (std::ranges::sized_range<const T>)
+		return sizeof(T) + std::ranges::size(value) * sizeof(std::ranges::range_value_t<const T>);
+	else
+		return sizeof(T);
+}
+
+/**
+ * @brief Sum statistics of all threads
+ */
+StatsSnapshot CollectStats();
+
+/**
+ * @brief Zero all statistics
+ *
+ * Counts recorded by other threads at the same time may be lost.
+ */
+void ResetStats();
+
+/**
+ * @brief Statistics as a JSON object
+ */
+std::string StatsToJson(const StatsSnapshot& stats);
+
+/**
+ * @brief Statistics in Prometheus text exposition format
+ */
+std::string StatsToPrometheus(const StatsSnapshot& stats);
+
+enum class StatsFormat { Json, Prometheus };
+
+/**
+ * @brief Collect statistics and write them to file
+ *
+ * @param path File to overwrite
+ * @param format Output format
+ * @return bool Whether the file was written
+ */
+bool DumpStats(const std::string& path, StatsFormat format = StatsFormat::Json);
+
+#endif
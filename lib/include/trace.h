@@ -0,0 +1,188 @@
+/**
+ * @file  trace.h
+ *
+ * @brief Implementation of the trace of forks, joins, merges and collapses.
+ */
+
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief Events are recorded only if built with VS_TRACE defined
+ *
+ * Otherwise every recording call is an empty inline function, and
+ * exported trace has no events.
+ */
+#ifdef VS_TRACE
+inline constexpr bool traceEnabled = true;
+#else
+inline constexpr bool traceEnabled = false;
+#endif
+
+/**
+ * @brief Timeline of Revision events, in per-thread ring buffers
+ *
+ * Each thread writes only its own buffer, and the oldest events are
+ * overwritten when it is full. Events are published the same way as
+ * slots of VersionStore are retagged, so the trace can be exported any
+ * time from any thread without locks on the recording side. Buffers of
+ * finished threads are reused by new ones, events keep the id of the
+ * thread that recorded them.
+ */
+class Trace
+{
+public:
+	/* events kept per thread */
+	static constexpr std::size_t capacity = 4096;
+
+	/**
+	 * @brief Event without duration
+	 *
+	 * @param name Event name, must be a string literal
+	 * @param argName Name of arg, must be a string literal
+	 * @param arg Segment version or variable id
+	 */
+	static void Instant(const char* name, const char* argName, std::uint64_t arg) {
+		if constexpr (traceEnabled)
+			Record(name, argName, arg, Now(), noDuration);
+	}
+
+	/**
+	 * @brief Event that lasts until the end of scope
+	 */
+	class Scope {
+	public:
+		Scope(const char* name, const char* argName, std::uint64_t arg) {
+			if constexpr (traceEnabled) {
+				_name = name;
+				_argName = argName;
+				_arg = arg;
+				_start = Now();
+			}
+		}
+
+		~Scope() {
+			if constexpr (traceEnabled)
+				Record(_name, _argName, _arg, _start, Now() - _start);
+		}
+
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+
+	private:
+		const char* _name;
+		const char* _argName;
+		std::uint64_t _arg;
+		std::uint64_t _start;
+	};
+
+private:
+	static constexpr std::uint64_t noDuration = ~std::uint64_t(0);
+
+	struct Event {
+		/* index of event plus one, 0 while it is written */
+		std::atomic<std::uint64_t> seq = 0;
+		std::atomic<const char*> name = nullptr;
+		std::atomic<const char*> argName = nullptr;
+		std::atomic<std::uint64_t> arg = 0;
+		std::atomic<std::uint64_t> ts = 0;
+		std::atomic<std::uint64_t> dur = 0;
+		std::atomic<std::uint32_t> tid = 0;
+	};
+
+	struct Buffer {
+		Event events[capacity];
+		std::atomic<std::uint64_t> head = 0;
+		/* buffer is written by several threads, only the one for exiting threads */
+		bool shared = false;
+		/* buffer is not used by any thread */
+		Buffer* nextFree = nullptr;
+	};
+
+	/**
+	 * @brief Nanoseconds since the first traced event
+	 */
+	static std::uint64_t Now() {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now() - epoch).count();
+	}
+
+	static void Record(const char* name, const char* argName, std::uint64_t arg,
+			std::uint64_t ts, std::uint64_t dur) {
+		Buffer& b = local ? *local : Attach();
+		std::uint64_t i = b.shared ? b.head.fetch_add(1, std::memory_order_relaxed)
+			: b.head.load(std::memory_order_relaxed);
+		Event& e = b.events[i % capacity];
+
+		/* same protocol as a seqlock, readers check seq after the fields */
+		e.seq.store(0, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		e.name.store(name, std::memory_order_relaxed);
+		e.argName.store(argName, std::memory_order_relaxed);
+		e.arg.store(arg, std::memory_order_relaxed);
+		e.ts.store(ts, std::memory_order_relaxed);
+		e.dur.store(dur, std::memory_order_relaxed);
+		e.tid.store(tid, std::memory_order_relaxed);
+		e.seq.store(i + 1, std::memory_order_release);
+		if (!b.shared)
+			b.head.store(i + 1, std::memory_order_release);
+	}
+
+	/**
+	 * @brief Give this thread a buffer
+	 */
+	static Buffer& Attach();
+
+	/**
+	 * @brief Give buffer of this thread back, when it exits
+	 */
+	static void Detach();
+
+	/**
+	 * @brief Buffer shared by exiting threads
+	 */
+	static Buffer& Exited();
+
+	friend struct TraceOwner;
+	friend struct TraceRegistry;
+	friend std::string TraceToJson();
+	friend void ResetTrace();
+
+	static const std::chrono::steady_clock::time_point epoch;
+
+	/* buffer of the thread, trivially destructible, so usable during thread exit */
+	thread_local static Buffer* local;
+	/* small sequential id of the thread, nicer in viewers than native ids */
+	thread_local static std::uint32_t tid;
+};
+
+/**
+ * @brief Recorded events in Chrome trace event format
+ *
+ * The result can be opened in chrome://tracing or Perfetto. Events
+ * with duration are "X" events, the rest are instant "i" events.
+ */
+std::string TraceToJson();
+
+/**
+ * @brief Drop all recorded events
+ *
+ * Events recorded by other threads at the same time may be kept.
+ */
+void ResetTrace();
+
+/**
+ * @brief Write recorded events to file in Chrome trace event format
+ *
+ * @param path File to overwrite
+ * @return bool Whether the file was written
+ */
+bool DumpTrace(const std::string& path);
+
+#endif
@@ -7,11 +7,19 @@
 #ifndef __VERSIONED_H__
 #define __VERSIONED_H__
 
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
 #include <iostream>
+#include <limits>
 #include <memory>
-#include <map>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
 #include "revision.h"
 #include "segment.h"
+#include "stats.h"
 
 /**
  * @brief Interface for all Versioned classes
@@ -20,9 +28,23 @@
 class VersionedI
 {
 public:
+	VersionedI() : id(idCount.fetch_add(1, std::memory_order_relaxed)) {}
+
+	/**
+	 * @brief Unique id of the variable, never reused
+	 *
+	 * @see ReadCache
+	 */
+	const std::uint64_t id;
+
 	virtual void Release(std::shared_ptr<Segment> release) = 0;
 	virtual void Collapse(std::shared_ptr<Revision> main, std::shared_ptr<Segment> parent) = 0;
-	virtual void Merge(std::shared_ptr<Revision> main, std::shared_ptr<Revision> joinRev, std::shared_ptr<Segment> join) = 0;
+	/* returns whether a version was written in main's current Segment */
+	virtual bool Merge(std::shared_ptr<Revision> main, std::shared_ptr<Revision> joinRev, std::shared_ptr<Segment> join) = 0;
+	virtual void Fold(std::shared_ptr<Revision> main, std::shared_ptr<Segment> parent, std::shared_ptr<Segment> child) = 0;
+
+private:
+	inline static std::atomic<std::uint64_t> idCount{1};
 };
 
 /* XXX: not really fits isMergeStrategy concept (no key and container here), but anyway */
@@ -44,6 +66,128 @@ class DefaultMergeStrategy
 	// }
 };
 
+/**
+ * @brief Flat storage of object versions, keyed by Segment version
+ *
+ * Most variables hold only a few live versions, so they sit in a small
+ * block of slots inside the Versioned object, and more blocks are chained
+ * on the heap only when it is full. Slots never move: Get hands out
+ * references to versions, and other threads read versions of ancestor
+ * Segments while we add our own. Slot ids are published atomically, so
+ * lookups and inserts of different versions need no locks.
+ *
+ * Each slot also remembers its Segment and its depth, so the version
+ * visible from some Segment is found by checking only the few stored
+ * versions against its ancestors, instead of walking the whole chain.
+ *
+ * @tparam T Stored type
+ * @tparam N Slots per block
+ */
+template <class T, int N = 4>
+class VersionStore
+{
+public:
+	typedef Segment::version_type version_type;
+
+	VersionStore() = default;
+	VersionStore(const VersionStore&) = delete;
+	VersionStore& operator=(const VersionStore&) = delete;
+
+	/**
+	 * @brief Destroy all versions and free spilled blocks
+	 */
+	~VersionStore();
+
+	/**
+	 * @brief Find version of Segment
+	 *
+	 * @param v Segment version
+	 * @return T* Pointer to object or nullptr if there is no such version
+	 */
+	T* find(version_type v) const;
+
+	/**
+	 * @brief Same as find, but throws std::out_of_range if nothing found
+	 */
+	T& at(version_type v) const;
+
+	/**
+	 * @brief Find version visible from Segment
+	 *
+	 * That is the version of the deepest Segment in chain of s,
+	 * s itself included. Takes O(size() * log depth).
+	 *
+	 * @param s Segment to look from
+	 * @param owner Set to Segment of found version, if not nullptr
+	 * @return T* Pointer to object or nullptr if there is no such version
+	 */
+	T* nearest(const Segment& s, const Segment** owner = nullptr) const;
+
+	/**
+	 * @brief Construct version of Segment in a free slot
+	 *
+	 * Version must not be already present. Segment must outlive its
+	 * version, as Segments release their versions anyway.
+	 *
+	 * @param s Segment that owns the version
+	 * @param args Arguments for T constructor
+	 * @return T& Constructed object
+	 */
+	template <class... Args>
+	T& emplace(const Segment& s, Args&&... args);
+
+	/**
+	 * @brief Destroy version of Segment, if it is present
+	 *
+	 * @param v Segment version
+	 * @return bool Whether version was present
+	 */
+	bool erase(version_type v);
+
+	/**
+	 * @brief Give version of one Segment to another one in place
+	 *
+	 * Object is not moved, so references to it stay valid. Concurrent
+	 * lookups wait for the few stores it takes instead of missing it.
+	 * New Segment must not have a version already.
+	 *
+	 * @param v Segment version
+	 * @param s Segment that owns the version from now on
+	 */
+	void retag(version_type v, const Segment& s);
+
+	/**
+	 * @brief Count of stored versions
+	 */
+	std::size_t size() const;
+
+private:
+	static constexpr version_type free_slot = std::numeric_limits<version_type>::max();
+	static constexpr version_type busy_slot = free_slot - 1;
+	/* slot is being retagged, lookups wait for it */
+	static constexpr version_type moving_slot = free_slot - 2;
+
+	struct Block {
+		std::atomic<version_type> ids[N];
+		std::atomic<const Segment*> owners[N];
+		std::atomic<Segment::depth_type> depths[N];
+		alignas(T) unsigned char slots[N][sizeof(T)];
+		std::atomic<Block*> next = nullptr;
+
+		Block() {
+			for (auto& id: ids)
+				id.store(free_slot, std::memory_order_relaxed);
+		}
+
+		T* slot(int i) {
+			return std::launder(reinterpret_cast<T*>(slots[i]));
+		}
+	};
+
+	/* first block is inline, so a few versions cost no allocations */
+	mutable Block head;
+};
+
 /**
  * @brief Wrapper to make any class Versioned
  *
@@ -53,12 +197,13 @@ template <class T, typename _Strategy = DefaultMergeStrategy<T>>
 class Versioned : public VersionedI {
 public:
 	/**
-	 * @brief Map of all versions of specified object
+	 * @brief All versions of specified object
 	 *
 	 * @details Segment versions where that object was changed are used as a keys
 	 * @see Segment
+	 * @see VersionStore
 	 */
-	std::map<int, T> versions;
+	VersionStore<T> versions;
 
 	/**
 	 * @brief Construct a new Versioned object from your object
@@ -67,6 +212,31 @@ public:
 	 */
 	Versioned(const T& val);
 
+	/**
+	 * @brief Construct a new Versioned object, moving your object in
+	 *
+	 * @param val Your object
+	 */
+	Versioned(T&& val);
+
+	/**
+	 * @brief Construct a new Versioned object from the current value of other
+	 *
+	 * Does not inherit versions history. Value is moved out only when
+	 * other wrote it in the current Segment, versions of ancestor Segments
+	 * are visible to other Revisions, so they are copied.
+	 *
+	 * @param other Versioned object to take value from
+	 */
+	Versioned(Versioned&& other);
+
+	/**
+	 * @brief Set current value of other as new value of the object
+	 *
+	 * Value is taken as in move constructor.
+	 */
+	Versioned& operator=(Versioned&& other);
+
 	/**
 	 * @brief Destroy the Versioned object
 	 *
@@ -95,6 +265,30 @@ public:
 	 */
 	bool Set(const T& v, const std::function<bool(T&)>& updater = nullptr);
 
+	/**
+	 * @brief Set new value of the object, moving it in
+	 *
+	 * Same as Set(const T&), the value is left unused if updater is
+	 * defined and the object was already written in current Segment.
+	 */
+	bool Set(T&& v, const std::function<bool(T&)>& updater = nullptr);
+
+	/**
+	 * @brief Update value of the object in-place
+	 *
+	 * Value visible in the current Revision is copied into the current
+	 * Segment on its first write there, later writes go straight to that
+	 * copy. If no other Revision can see that value, it is moved instead.
+	 * Unlike Set with updater, nothing is type-erased, so updater gets
+	 * inlined.
+	 *
+	 * @param updater Callable that takes T& and returns bool
+	 *
+	 * @return bool result of updater
+	 */
+	template <class F>
+	bool Update(F&& updater);
+
 	/**
 	 * @brief Forget version that was changed in some Segment
 	 *
@@ -117,18 +311,34 @@ public:
 	 * @param main Revision to merge into
 	 * @param joinRev Revision to merge
 	 * @param join Segment to which to merge
+	 * @return bool Whether a version was written in main
+	 */
+	bool Merge(std::shared_ptr<Revision> main, std::shared_ptr<Revision> joinRev, std::shared_ptr<Segment> join) override;
+
+	/**
+	 * @brief Give version of unshared Segment to its only child
+	 *
+	 * Other Revisions may read through child, so visible version is
+	 * retagged in place rather than moved.
+	 *
+	 * @param main Revision whose chain has both Segments
+	 * @param parent Segment to take version from
+	 * @param child Segment whose parent it is
 	 */
-	void Merge(std::shared_ptr<Revision> main, std::shared_ptr<Revision> joinRev, std::shared_ptr<Segment> join) override;
+	void Fold(std::shared_ptr<Revision> main, std::shared_ptr<Segment> parent, std::shared_ptr<Segment> child) override;
 
 private:
 
 	/**
 	 * @brief Get value of versioned object by Revision
 	 *
+	 * Resolved value is kept in Revision's cache until the object is
+	 * written in the current Segment or the Segment is collapsed.
+	 *
 	 * @param r Revision to use
 	 * @return T Object value
 	 */
-	const T& Get(std::shared_ptr<Revision> r) const;
+	const T& Get(const std::shared_ptr<Revision>& r) const;
 
 	/**
 	 * @brief Set object value in specified Revision
@@ -142,13 +352,32 @@ private:
 	 * If there is no version for this revision, create it
 	 * else overwrite current item
 	 */
-	bool Set(std::shared_ptr<Revision> r, const T& value, const std::function<bool(T&)>& updater = nullptr);
+	template <class U>
+	bool Set(std::shared_ptr<Revision> r, U&& value, const std::function<bool(T&)>& updater = nullptr);
+
+	/**
+	 * @brief Set current value of other in current Revision
+	 *
+	 * Moves it out of other if it was written in current Segment.
+	 */
+	void SetFrom(Versioned& other);
 
 
 	/**
 	 * @brief Like Set, but use _Strategy to write instead
+	 *
+	 * @param steal Value is not seen by anyone else, so it may be moved
+	 *              or drained by _Strategy, otherwise _Strategy gets a copy
 	 */
-	bool SetMerge(std::shared_ptr<Revision> r, T& value);
+	bool SetMerge(std::shared_ptr<Revision> r, T& value, bool steal);
+
+	/**
+	 * @brief Count new version in Stats, does nothing unless built with VS_STATS
+	 *
+	 * @param value New version
+	 * @param copied Whether it was copied rather than moved
+	 */
+	void Counted(const T& value, bool copied) const;
 
 	/**
 	 * @brief Injected from versioned collections
@@ -159,27 +388,201 @@ private:
 
 // All methods need to be decalred in header due to template linking issues
 
+template <class T, int N>
+VersionStore<T,N>::~VersionStore() {
+	Block* b = &head;
+
+	while (b) {
+		for (int i = 0; i < N; i++) {
+			version_type id = b->ids[i].load(std::memory_order_acquire);
+			if (id != free_slot && id != busy_slot)
+				b->slot(i)->~T();
+		}
+
+		Block* next = b->next.load(std::memory_order_acquire);
+		if (b != &head)
+			delete b;
+		b = next;
+	}
+}
+
+template <class T, int N>
+T* VersionStore<T,N>::find(version_type v) const {
+	for (Block* b = &head; b; b = b->next.load(std::memory_order_acquire)) {
+		for (int i = 0; i < N; i++) {
+			if (b->ids[i].load(std::memory_order_acquire) == v)
+				return b->slot(i);
+		}
+	}
+	return nullptr;
+}
+
+template <class T, int N>
+T& VersionStore<T,N>::at(version_type v) const {
+	T* res = find(v);
+	if (!res)
+		throw std::out_of_range("VersionStore::at");
+	return *res;
+}
+
+template <class T, int N>
+T* VersionStore<T,N>::nearest(const Segment& s, const Segment** owner) const {
+	T* res = nullptr;
+	const Segment* res_owner = nullptr;
+	Segment::depth_type best = -1;
+
+	for (Block* b = &head; b; b = b->next.load(std::memory_order_acquire)) {
+		for (int i = 0; i < N; i++) {
+			version_type id = b->ids[i].load(std::memory_order_acquire);
+			while (id == moving_slot)
+				id = b->ids[i].load(std::memory_order_acquire);
+			if (id == free_slot || id == busy_slot)
+				continue;
+
+			/* owner is only compared, other threads may free it any time */
+			const Segment* owner = b->owners[i].load(std::memory_order_relaxed);
+			Segment::depth_type depth = b->depths[i].load(std::memory_order_relaxed);
+			/* slot changed while we read it, look at it again */
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (b->ids[i].load(std::memory_order_relaxed) != id) {
+				i--;
+				continue;
+			}
+
+			if (depth > best && depth <= s.depth && s.Ancestor(depth) == owner) {
+				res = b->slot(i);
+				res_owner = owner;
+				best = depth;
+			}
+		}
+	}
+	if (owner)
+		*owner = res_owner;
+	return res;
+}
+
+template <class T, int N>
+template <class... Args>
+T& VersionStore<T,N>::emplace(const Segment& s, Args&&... args) {
+	Block* b = &head;
+
+	while (true) {
+		for (int i = 0; i < N; i++) {
+			version_type expected = free_slot;
+			if (b->ids[i].load(std::memory_order_relaxed) != free_slot ||
+				!b->ids[i].compare_exchange_strong(expected, busy_slot, std::memory_order_acquire))
+				continue;
+
+			T* res;
+			try {
+				res = ::new (b->slots[i]) T(std::forward<Args>(args)...);
+			} catch (...) {
+				b->ids[i].store(free_slot, std::memory_order_release);
+				throw;
+			}
+			b->owners[i].store(&s, std::memory_order_relaxed);
+			b->depths[i].store(s.depth, std::memory_order_relaxed);
+			b->ids[i].store(s.version, std::memory_order_release);
+			return *res;
+		}
+
+		Block* next = b->next.load(std::memory_order_acquire);
+		if (!next) {
+			Block* fresh = new Block();
+			if (b->next.compare_exchange_strong(next, fresh, std::memory_order_acq_rel))
+				next = fresh;
+			else
+				delete fresh;
+		}
+		b = next;
+	}
+}
+
+template <class T, int N>
+bool VersionStore<T,N>::erase(version_type v) {
+	for (Block* b = &head; b; b = b->next.load(std::memory_order_acquire)) {
+		for (int i = 0; i < N; i++) {
+			if (b->ids[i].load(std::memory_order_acquire) != v)
+				continue;
+
+			b->ids[i].store(busy_slot, std::memory_order_relaxed);
+			b->slot(i)->~T();
+			b->ids[i].store(free_slot, std::memory_order_release);
+			return true;
+		}
+	}
+	return false;
+}
+
+template <class T, int N>
+void VersionStore<T,N>::retag(version_type v, const Segment& s) {
+	for (Block* b = &head; b; b = b->next.load(std::memory_order_acquire)) {
+		for (int i = 0; i < N; i++) {
+			if (b->ids[i].load(std::memory_order_acquire) != v)
+				continue;
+
+			/* same protocol as a seqlock, nearest rereads slot id after the fields */
+			b->ids[i].store(moving_slot, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			b->owners[i].store(&s, std::memory_order_relaxed);
+			b->depths[i].store(s.depth, std::memory_order_relaxed);
+			b->ids[i].store(s.version, std::memory_order_release);
+			return;
+		}
+	}
+}
+
+template <class T, int N>
+std::size_t VersionStore<T,N>::size() const {
+	std::size_t res = 0;
+
+	for (Block* b = &head; b; b = b->next.load(std::memory_order_acquire)) {
+		for (int i = 0; i < N; i++) {
+			version_type id = b->ids[i].load(std::memory_order_relaxed);
+			res += (id != free_slot && id != busy_slot);
+		}
+	}
+	return res;
+}
+
+
 template <class T, typename _Strategy>
 Versioned<T,_Strategy>::Versioned(const T& v) {
     Set(Revision::currentRevision, v);
 }
 
+template <class T, typename _Strategy>
+Versioned<T,_Strategy>::Versioned(T&& v) {
+    Set(Revision::currentRevision, std::move(v));
+}
+
+template <class T, typename _Strategy>
+Versioned<T,_Strategy>::Versioned(Versioned&& other)
+: merge_strategy(std::move(other.merge_strategy)) {
+    SetFrom(other);
+}
+
+template <class T, typename _Strategy>
+Versioned<T,_Strategy>& Versioned<T,_Strategy>::operator=(Versioned&& other) {
+    if (this != &other)
+        SetFrom(other);
+    return *this;
+}
+
 template <class T, typename _Strategy>
 inline Versioned<T,_Strategy>::~Versioned()
 {
 	std::shared_ptr<Segment> s = Revision::currentRevision->current;
 
 	while (s) {
-        if (versions.find(s->version) != versions.end()) {
-			for (auto it = s->written.begin(); it != s->written.end();){
-				if (*it == this)
-					it = s->written.erase(it);
-				else
-					it++;
-			}
-		}
+        if (versions.find(s->version))
+			s->written.erase(this);
         s = s->parent;
     }
+
+	/* the rest is destroyed with the store */
+	if constexpr (statsEnabled)
+		Stats::Released(versions.size());
 }
 
 template <class T, typename _Strategy>
@@ -188,17 +591,25 @@ const T& Versioned<T,_Strategy>::Get() const{
 }
 
 template <class T, typename _Strategy>
-const T& Versioned<T,_Strategy>::Get(std::shared_ptr<Revision> r) const{
-    std::shared_ptr<Segment> s = r->current;
-
-    while (versions.find(s->version) == versions.end()) {
-        if (!s->parent)
-            break;
-
-        s = s->parent;
+const T& Versioned<T,_Strategy>::Get(const std::shared_ptr<Revision>& r) const{
+    Segment::version_type cur = r->current->version;
+    if (const void* cached = r->cache.find(id, cur)) {
+        Stats::Get(true);
+        return *static_cast<const T*>(cached);
     }
 
-    return versions.at(s->version);
+    const Segment* owner = r->current.get();
+    const T* v = versions.find(cur);
+    if (!v)
+        v = versions.nearest(*r->current, &owner);
+    if (!v)
+        throw std::out_of_range("Versioned::Get");
+
+    /* owner is an ancestor of current Segment, so it is alive */
+    Stats::Get(false);
+    Stats::ChainWalk(r->current->depth - owner->depth);
+    r->cache.store(id, cur, v);
+    return *v;
 }
 
 template <class T, typename _Strategy>
@@ -207,59 +618,146 @@ bool Versioned<T,_Strategy>::Set(const T& v, const std::function<bool(T&)>& upda
 }
 
 template <class T, typename _Strategy>
-bool Versioned<T,_Strategy>::Set(std::shared_ptr<Revision> r, const T& value, const std::function<bool(T&)>& updater) {
-	if (versions.find(r->current->version) == versions.end()) {
-		r->current->written.push_back(this);
-		versions[r->current->version] = value;
+bool Versioned<T,_Strategy>::Set(T&& v, const std::function<bool(T&)>& updater) {
+	return Set(Revision::currentRevision, std::move(v), updater);
+}
+
+template <class T, typename _Strategy>
+template <class F>
+bool Versioned<T,_Strategy>::Update(F&& updater) {
+	Revision& r = *Revision::currentRevision;
+	T* cur = versions.find(r.current->version);
+	if (!cur) {
+		const Segment* owner;
+		T* v = versions.nearest(*r.current, &owner);
+		if (!v)
+			throw std::out_of_range("Versioned::Update");
+
+		/*
+		 * Slots never move, so v stays valid while we add ours. Moved-from
+		 * value stays in its slot until owner is released, but it is
+		 * never read again, as our version is nearer.
+		 */
+		r.current->written.insert(this);
+		bool copied = !r.current->Unshared(owner);
+		if (copied)
+			cur = &versions.emplace(*r.current, *v);
+		else
+			cur = &versions.emplace(*r.current, std::move(*v));
+		Counted(*cur, copied);
+		r.cache.invalidate(id);
+	}
+	return std::forward<F>(updater)(*cur);
+}
+
+template <class T, typename _Strategy>
+template <class U>
+bool Versioned<T,_Strategy>::Set(std::shared_ptr<Revision> r, U&& value, const std::function<bool(T&)>& updater) {
+	T* cur = versions.find(r->current->version);
+	if (!cur) {
+		r->current->written.insert(this);
+		cur = &versions.emplace(*r->current, std::forward<U>(value));
+		Counted(*cur, std::is_lvalue_reference_v<U>);
+		r->cache.invalidate(id);
 		if (updater){
-			return updater(versions[r->current->version]);
+			return updater(*cur);
 		}
 	} else {
 		if (updater){
-			return updater(versions[r->current->version]);
+			return updater(*cur);
 		} else {
-			versions[r->current->version] = value;
+			*cur = std::forward<U>(value);
 		}
 	}
 	return true;
 }
 
 template <class T, typename _Strategy>
-bool Versioned<T,_Strategy>::SetMerge(std::shared_ptr<Revision> r, T& value){
-	if (versions.find(r->current->version) == versions.end()) {
-		r->current->written.push_back(this);
-		versions[r->current->version] = value;
+void Versioned<T,_Strategy>::SetFrom(Versioned& other) {
+	const std::shared_ptr<Revision>& r = Revision::currentRevision;
+
+	if (T* own = other.versions.find(r->current->version))
+		Set(r, std::move(*own));
+	else
+		Set(r, other.Get(r));
+}
+
+template <class T, typename _Strategy>
+bool Versioned<T,_Strategy>::SetMerge(std::shared_ptr<Revision> r, T& value, bool steal){
+	T* cur = versions.find(r->current->version);
+	if (!cur) {
+		r->current->written.insert(this);
+		T& cur = steal ? versions.emplace(*r->current, std::move(value)) : versions.emplace(*r->current, value);
+		Counted(cur, !steal);
+		r->cache.invalidate(id);
+	} else if (steal) {
+		merge_strategy.merge(*cur, value);
 	} else {
-		merge_strategy.merge(versions[r->current->version], value);
+		/* strategies may drain their source, which is pinned by a snapshot or sibling */
+		T copy = value;
+		if constexpr (statsEnabled)
+			Stats::Copy(StatsBytes(copy));
+		merge_strategy.merge(*cur, copy);
 	}
 	return true;
 }
 
 template <class T, typename _Strategy>
 void Versioned<T,_Strategy>::Release(std::shared_ptr<Segment> release) {
-	versions.erase(release->version);
+	if (versions.erase(release->version))
+		Stats::Released();
+}
+
+template <class T, typename _Strategy>
+void Versioned<T,_Strategy>::Counted(const T& value, bool copied) const {
+	if constexpr (statsEnabled) {
+		if (copied)
+			Stats::Copy(StatsBytes(value));
+		else
+			Stats::Move();
+		Stats::Created(versions.size());
+	}
 }
 
 template <class T, typename _Strategy>
 void Versioned<T,_Strategy>::Collapse(std::shared_ptr<Revision> main, std::shared_ptr<Segment> parent) {
-    if (versions.find(main->current->version) == versions.end()) {
-        Set(main, versions[parent->version]);
+    Stats::CollapseTimer<_Strategy> timer;
+
+    /* parent is unshared and released right after, so its value is moved */
+    T* v = versions.find(parent->version);
+    if (v && !versions.find(main->current->version)) {
+        Set(main, std::move(*v));
     }
+    main->cache.invalidate(id);
     Release(parent);
 }
 
 template <class T, typename _Strategy>
-void Versioned<T,_Strategy>::Merge(std::shared_ptr<Revision> main, std::shared_ptr<Revision> joinRev, std::shared_ptr<Segment> join) {
-    std::shared_ptr<Segment> s = joinRev->current;
-    while (versions.find(s->version) == versions.end()) {
-        if (!s->parent)
-            break;
-
-        s = s->parent;
+void Versioned<T,_Strategy>::Fold(std::shared_ptr<Revision> main, std::shared_ptr<Segment> parent, std::shared_ptr<Segment> child) {
+    if (!versions.find(parent->version))
+        return;
+
+    /* child's version hides it from everyone who can see parent */
+    if (versions.find(child->version)) {
+        Release(parent);
+    } else {
+        versions.retag(parent->version, *child);
+        child->written.insert(this);
+        Stats::Fold();
     }
-    if (s == join) {
-        SetMerge(main, versions[join->version]);
+    main->cache.invalidate(id);
+}
+
+template <class T, typename _Strategy>
+bool Versioned<T,_Strategy>::Merge(std::shared_ptr<Revision> main, std::shared_ptr<Revision> joinRev, std::shared_ptr<Segment> join) {
+    /* merge only if nothing newer is visible in joinRev */
+    T* v = versions.find(join->version);
+    if (v && versions.nearest(*joinRev->current) == v) {
+        Stats::MergeTimer<_Strategy> timer;
+        /* joinRev is released after join, so take value if only it sees it */
+        return SetMerge(main, *v, joinRev->current->Unshared(join.get()));
     }
+    return false;
 }
 
 #endif
\ No newline at end of file
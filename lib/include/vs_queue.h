@@ -5,10 +5,14 @@
 #include <queue>
 #include <initializer_list>
 #include <iterator>
+#include <ranges>
+#include <utility>
 
 #include "versioned.h"
 #include "revision.h"
 #include "strategy.h"
+#include "vs_snapshot.h"
+#include "persistent_queue.h"
 
 namespace vs
 {
@@ -21,19 +25,23 @@ namespace vs
 	 *
 	 *  @param _Key  Type of key objects.
 	 *  @param _Strategy  Custom strategy class for different merge behaviour
+	 *  @param _Queue  Queue that holds one version, std::queue or
+	 *  persistent_queue. persistent_queue shares elements between versions,
+	 *  so a fork copies nothing.
 	 */
-	template<typename _Key, typename _Strategy = vs_queue_strategy<_Key>>
+	template<typename _Key, typename _Strategy = vs_queue_strategy<_Key>,
+		typename _Queue = std::queue<_Key>>
 	class vs_queue
 	{
 
-	static_assert(vs::IsMergeStrategy<_Strategy, std::queue<_Key>>, 
+	static_assert(vs::IsMergeStrategy<_Strategy, _Queue>, 
 		"Provided invalid strategy class in template");
 
 	public:
 	/* public typedefs */
 
-	typedef Versioned<std::queue<_Key>, _Strategy> _Versioned;
-	typedef std::queue<_Key>::size_type size_type;
+	typedef Versioned<_Queue, _Strategy> _Versioned;
+	typedef _Queue::size_type size_type;
 
 	private:
 
@@ -47,7 +55,7 @@ namespace vs
 	 */
 	explicit
 	vs_queue()
-	: _v_q(std::queue<_Key>()) { }
+	: _v_q(_Queue()) { }
 
 	/**
 	 * @brief  Builds a vs_queue from an initializer_list.
@@ -58,10 +66,9 @@ namespace vs
 	 * Non-standard, but handy to have instead of copying with queue{{initilizer}}
 	 */
 	vs_queue(std::initializer_list<_Key> __l)
-	: _v_q(std::queue<_Key>()) 
+	: _v_q(_Queue()) 
 	{
-		_v_q.Set(_v_q.Get(),
-		[&](std::queue<_Key>& _queue){
+		_v_q.Update([&](_Queue& _queue){
 			for (auto& i: __l){
 				_queue.push(i);
 			}
@@ -77,9 +84,29 @@ namespace vs
 	vs_queue(const vs_queue& __vs_queue)
 	: _v_q(__vs_queue._v_q.Get()) { }
 
-	//*  @brief %queue move constructor
+	/**
+	 * @brief  vs_queue move constructor
+	 *
+	 * does not inherit versions history, current version of __vs_queue
+	 * is moved instead of copied if it was written in current segment
+	 */
+	vs_queue(vs_queue&& __vs_queue)
+	: _v_q(std::move(__vs_queue._v_q)) { }
 
-	//*  @brief  Builds a %queue from a range.
+	/**
+	 * @brief  Builds a vs_queue from a range.
+	 * @param  __first  An input iterator.
+	 * @param  __last  An input iterator.
+	 *
+	 * Elements are pushed in order of the range, only one version gets
+	 * added.
+	 */
+	template<typename _InputIterator>
+	vs_queue(_InputIterator __first, _InputIterator __last)
+	: _v_q(_Queue())
+	{
+		push(__first, __last);
+	}
 
 	/* ------------------ Accessors ----------------------*/
 
@@ -110,6 +137,17 @@ namespace vs
 	size() const noexcept
 	{ return _v_q.Get().size(); }
 
+	/**
+	 * @brief read-only snapshot of the vs_queue
+	 *
+	 * Freezes the current state: later changes in this Revision, joins
+	 * and merges are not seen through the snapshot, and it can be read
+	 * from any thread. The vs_queue must outlive the snapshot.
+	 */
+	vs::snapshot<_Queue>
+	snapshot() const
+	{ return vs::snapshot<_Queue>(_v_q); }
+
 	/* ------------------ Operators ----------------------*/
 
 	/**
@@ -119,7 +157,60 @@ namespace vs
 	void
 	push(const _Key& __x)
 	{
-		_v_q.Set(_v_q.Get(), [&](std::queue<_Key>& _queue){ _queue.push(__x); return true; });
+		_v_q.Update([&](_Queue& _queue){ _queue.push(__x); return true; });
+	}
+
+	/**
+	 * @brief Moves an element into the queue.
+	 * @param  __x  Element to be inserted.
+	 */
+	void
+	push(_Key&& __x)
+	{
+		_v_q.Update([&](_Queue& _queue){ _queue.push(std::move(__x)); return true; });
+	}
+
+	/**
+	 * @brief Builds an element at the back of the queue.
+	 * @param  __args  Arguments for the element constructor.
+	 */
+	template<typename... _Args>
+	void
+	emplace(_Args&&... __args)
+	{
+		_v_q.Update([&](_Queue& _queue){ _queue.emplace(std::forward<_Args>(__args)...); return true; });
+	}
+
+	/**
+	 * @brief Pushes elements of a range in one versioned write.
+	 * @param  __first  An input iterator.
+	 * @param  __last  An input iterator.
+	 */
+	template<typename _InputIterator>
+	void
+	push(_InputIterator __first, _InputIterator __last)
+	{
+		if (__first == __last)
+			return;
+
+		_v_q.Update([&](_Queue& _queue){
+			for (; __first != __last; ++__first){
+				_queue.push(*__first);
+			}
+			return true;
+		});
+	}
+
+	/**
+	 * @brief Pushes elements of a range in one versioned write.
+	 * @param  __rg  Range of elements to be pushed.
+	 */
+	template<std::ranges::input_range _Range>
+	void
+	push_range(_Range&& __rg)
+	{
+		auto __common = std::forward<_Range>(__rg) | std::views::common;
+		push(std::ranges::begin(__common), std::ranges::end(__common));
 	}
 
 	/**
@@ -129,9 +220,30 @@ namespace vs
 	pop()
 	{
 		if (_v_q.Get().size() > 0)
-			_v_q.Set(_v_q.Get(), [](std::queue<_Key>& _queue){ _queue.pop(); return true; });
+			_v_q.Update([](_Queue& _queue){ _queue.pop(); return true; });
+	}
+	/**
+	 * @brief  vs_queue copy assignment
+	 *
+	 * Current version of __vs_queue becomes a new version of this one.
+	 */
+	vs_queue&
+	operator=(const vs_queue& __vs_queue)
+	{
+		if (this != &__vs_queue)
+			_v_q.Set(__vs_queue._v_q.Get());
+		return *this;
+	}
+
+	/**
+	 * @brief  vs_queue move assignment
+	 */
+	vs_queue&
+	operator=(vs_queue&& __vs_queue)
+	{
+		_v_q = std::move(__vs_queue._v_q);
+		return *this;
 	}
-	// = (copy)
 	// = {}
 	};
 
@@ -141,14 +253,17 @@ namespace vs
 	 * On merge, puts everything from one queue to other. It is expected to
 	 * start with empty queues and merge remainders, or for user to override
 	 * this strategy.
+	 *
+	 * Works with any _Queue backend that vs_queue accepts.
 	 */
 	template<typename _Key>
 	class vs_queue_strategy
 	{
 	public:
 
+	template<typename _Queue>
 	void
-	merge(std::queue<_Key>& dst, std::queue<_Key>& src)
+	merge(_Queue& dst, _Queue& src)
 	{
 		while (src.size() > 0)
 		{
@@ -157,17 +272,18 @@ namespace vs
 		}
 	}
 
+	template<typename _Queue>
 	void
-	merge_same_element(std::queue<_Key>& dst, _Key& dstk, _Key& srck)
+	merge_same_element(_Queue& dst, _Key& dstk, _Key& srck)
 	{
 		dst.push(srck);
 	}
 
 	};
 
-	template<typename _Key>
-	std::ostream& operator << (std::ostream& os, vs_queue<_Key> const& value) {
-		vs_queue<_Key> temp = value;
+	template<typename _Key, typename _Strategy, typename _Queue>
+	std::ostream& operator << (std::ostream& os, vs_queue<_Key, _Strategy, _Queue> const& value) {
+		vs_queue<_Key, _Strategy, _Queue> temp = value;
 
 		std::ostringstream o;
 		o << "{ ";
@@ -0,0 +1,368 @@
+#ifndef _VS_REVISION_TASK_H
+#define _VS_REVISION_TASK_H
+
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include "pool_allocator.h"
+#include "revision.h"
+#include "vs_task.h"
+
+namespace vs {
+
+    template <typename T = void>
+    class revision_task;
+
+    /* internal class */
+
+    /**
+     * @brief Storage for the result of revision_task
+     */
+    template <typename T>
+    struct _revision_result {
+        std::optional<T> value;
+
+        void return_value(T v) { value.emplace(std::move(v)); }
+
+        T take() { return std::move(*value); }
+    };
+
+    template <>
+    struct _revision_result<void> {
+        void return_void() { }
+
+        void take() { }
+    };
+
+    /* internal class */
+
+    /**
+     * @brief Blocking waiter for revision_task::get
+     */
+    struct _revision_sync_waiter {
+        std::mutex mutex;
+        std::condition_variable cv;
+        bool done = false;
+
+        void wake() {
+            std::lock_guard<std::mutex> lock(mutex);
+            done = true;
+            cv.notify_one();
+        }
+
+        void wait() {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [this]() { return done; });
+        }
+    };
+
+    /* internal class */
+
+    /**
+     * @brief Coroutine that switches to Revision of a suspended
+     * revision_task and transfers control to it
+     *
+     * Awaiters get its handle instead of the handle of revision_task,
+     * so the switch happens as the very first thing on resumption, on
+     * whatever thread resumes it. The frame frees itself on transfer.
+     */
+    struct _revision_resumer {
+        struct promise_type {
+            template <typename... Args>
+            promise_type(std::coroutine_handle<> target, Args&&...)
+            : target(target) { }
+
+            _revision_resumer get_return_object() {
+                return {std::coroutine_handle<promise_type>::from_promise(*this)};
+            }
+
+            std::suspend_always initial_suspend() noexcept { return {}; }
+
+            auto final_suspend() noexcept {
+                struct TransferAwaiter {
+                    bool await_ready() noexcept { return false; }
+
+                    std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+                        std::coroutine_handle<> target = h.promise().target;
+                        h.destroy();
+                        return target;
+                    }
+
+                    void await_resume() noexcept { }
+                };
+                return TransferAwaiter{};
+            }
+
+            void return_void() { }
+
+            void unhandled_exception() { std::terminate(); }
+
+            std::coroutine_handle<> target;
+        };
+
+        std::coroutine_handle<promise_type> handle;
+    };
+
+    /* internal */
+    inline _revision_resumer _switch_revision(std::coroutine_handle<>, std::shared_ptr<Revision>* revision,
+            std::shared_ptr<Revision>* saved) {
+        *saved = std::move(Revision::currentRevision);
+        Revision::currentRevision = *revision;
+        co_return;
+    }
+
+    /* internal class */
+
+    /**
+     * @brief Wraps any awaiter used inside revision_task
+     *
+     * Coroutine can be resumed by any thread, and suspension hands the
+     * thread back to whoever resumed it. So the Revision of that thread is
+     * put back on suspension, and Revision of the coroutine is switched in
+     * again on resumption, by passing _revision_resumer to the awaiter.
+     * The switch can't wait for await_resume, as gcc evaluates other
+     * operands of the enclosing expression before it.
+     */
+    template <typename Awaiter>
+    struct _revision_awaiter {
+        Awaiter inner;
+        std::shared_ptr<Revision>* revision;
+        std::shared_ptr<Revision>* saved;
+
+        bool await_ready() { return inner.await_ready(); }
+
+        auto await_suspend(std::coroutine_handle<> h) {
+            std::coroutine_handle<> resumer = _switch_revision(h, revision, saved).handle;
+            Revision::currentRevision = std::move(*saved);
+
+            using Result = decltype(inner.await_suspend(resumer));
+            if constexpr (std::is_same_v<Result, bool>) {
+                if (inner.await_suspend(resumer))
+                    return true;
+
+                /* not suspended after all */
+                resumer.destroy();
+                *saved = std::move(Revision::currentRevision);
+                Revision::currentRevision = *revision;
+                return false;
+            } else {
+                return inner.await_suspend(resumer);
+            }
+        }
+
+        decltype(auto) await_resume() { return inner.await_resume(); }
+    };
+
+    /* internal */
+
+    /**
+     * @brief Get awaiter from awaitable, by member operator co_await if any
+     */
+    template <typename Awaitable>
+    decltype(auto) _get_awaiter(Awaitable&& a) {
+        if constexpr (requires { std::forward<Awaitable>(a).operator co_await(); })
+            return std::forward<Awaitable>(a).operator co_await();
+        else
+            return std::forward<Awaitable>(a);
+    }
+
+    /**
+     * @brief Coroutine that runs in its own Revision
+     *
+     * Calling the coroutine forks a Revision from the caller's current
+     * one and queues the coroutine body on the worker pool, where it runs
+     * with its Revision as Revision::currentRevision, across all its
+     * suspension points. Awaiting the revision_task from another
+     * coroutine does the same merge as vs::thread::join and gives the
+     * returned value, without blocking any thread while it runs. Code
+     * outside of coroutines uses blocking get() instead.
+     *
+     * Like vs::thread, a revision_task must be awaited or got exactly
+     * once, from the Revision it was started in.
+     *
+     * @tparam T Type of the returned value
+     */
+    template <typename T>
+    class revision_task {
+    public:
+        struct promise_type : _revision_result<T> {
+            /* Revision the body runs in */
+            std::shared_ptr<Revision> revision;
+            /* Revision of the thread that runs the body now */
+            std::shared_ptr<Revision> saved;
+            std::exception_ptr error;
+            /*
+             * nullptr while running, then the address of awaiting coroutine
+             * or tagged sync waiter, and finally finishedMark
+             */
+            std::atomic<std::uintptr_t> waiter = 0;
+
+            revision_task get_return_object() {
+                return revision_task(std::coroutine_handle<promise_type>::from_promise(*this));
+            }
+
+            auto initial_suspend() noexcept {
+                struct StartAwaiter {
+                    promise_type& p;
+
+                    bool await_ready() noexcept { return false; }
+
+                    void await_suspend(std::coroutine_handle<promise_type> h) {
+                        p.revision = ForkRevision();
+                        WorkerPool::instance().submit(MakePooled<ResumeJob>(h));
+                    }
+
+                    void await_resume() noexcept {
+                        p.saved = std::move(Revision::currentRevision);
+                        Revision::currentRevision = p.revision;
+                    }
+                };
+                return StartAwaiter{*this};
+            }
+
+            auto final_suspend() noexcept {
+                struct FinalAwaiter {
+                    bool await_ready() noexcept { return false; }
+
+                    std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+                        promise_type& p = h.promise();
+                        Revision::currentRevision = std::move(p.saved);
+
+                        /* frame can be destroyed by the waiter right after this */
+                        std::uintptr_t w = p.waiter.exchange(finishedMark, std::memory_order_acq_rel);
+                        if (w & syncTag) {
+                            reinterpret_cast<_revision_sync_waiter*>(w & ~syncTag)->wake();
+                        } else if (w) {
+                            return std::coroutine_handle<>::from_address(reinterpret_cast<void*>(w));
+                        }
+                        return std::noop_coroutine();
+                    }
+
+                    void await_resume() noexcept { }
+                };
+                return FinalAwaiter{};
+            }
+
+            void unhandled_exception() { error = std::current_exception(); }
+
+            template <typename Awaitable>
+            auto await_transform(Awaitable&& a) {
+                using Awaiter = decltype(_get_awaiter(std::forward<Awaitable>(a)));
+                return _revision_awaiter<Awaiter>{_get_awaiter(std::forward<Awaitable>(a)), &revision, &saved};
+            }
+        };
+
+        revision_task(revision_task&& other) noexcept
+        : handle(std::exchange(other.handle, nullptr)) { }
+
+        revision_task& operator=(revision_task&& other) noexcept {
+            if (handle)
+                std::terminate();
+            handle = std::exchange(other.handle, nullptr);
+            return *this;
+        }
+
+        ~revision_task() {
+            if (handle)
+                std::terminate();
+        }
+
+        /**
+         * @brief Awaiter that joins the Revision and gives the value
+         */
+        auto operator co_await() && noexcept {
+            struct JoinAwaiter {
+                revision_task& task;
+
+                bool await_ready() noexcept {
+                    return task.handle.promise().waiter.load(std::memory_order_acquire) == finishedMark;
+                }
+
+                bool await_suspend(std::coroutine_handle<> h) noexcept {
+                    std::uintptr_t expected = 0;
+                    /* fails if it has finished in the meantime, then go on */
+                    return task.handle.promise().waiter.compare_exchange_strong(expected,
+                        reinterpret_cast<std::uintptr_t>(h.address()), std::memory_order_acq_rel);
+                }
+
+                T await_resume() { return task.join(); }
+            };
+            return JoinAwaiter{*this};
+        }
+
+        /**
+         * @brief Wait for the coroutine and join its Revision
+         *
+         * Blocks calling thread, helping the worker pool while there is
+         * queued work. Don't call it from inside revision_task, co_await
+         * the task instead.
+         */
+        T get() {
+            promise_type& p = handle.promise();
+            WorkerPool& pool = WorkerPool::instance();
+
+            while (p.waiter.load(std::memory_order_acquire) != finishedMark && pool.runOne())
+                ;
+
+            _revision_sync_waiter sync;
+            std::uintptr_t expected = 0;
+            if (p.waiter.compare_exchange_strong(expected, reinterpret_cast<std::uintptr_t>(&sync) | syncTag,
+                    std::memory_order_acq_rel))
+                sync.wait();
+
+            return join();
+        }
+
+    private:
+        static constexpr std::uintptr_t syncTag = 1;
+        static constexpr std::uintptr_t finishedMark = ~std::uintptr_t(0);
+
+        /* queued start of the coroutine body */
+        struct ResumeJob : Job {
+            explicit ResumeJob(std::coroutine_handle<promise_type> h) : h(h) { }
+
+            void run() override { h.resume(); }
+
+            std::coroutine_handle<promise_type> h;
+        };
+
+        explicit revision_task(std::coroutine_handle<promise_type> h)
+        : handle(h) { }
+
+        /**
+         * @brief Merge finished coroutine into current Revision and free it
+         */
+        T join() {
+            std::coroutine_handle<promise_type> h = std::exchange(handle, nullptr);
+            promise_type& p = h.promise();
+
+            JoinRevision(std::move(p.revision));
+
+            std::exception_ptr error = p.error;
+            if (error) {
+                h.destroy();
+                std::rethrow_exception(error);
+            }
+
+            if constexpr (std::is_void_v<T>) {
+                h.destroy();
+            } else {
+                T res = p.take();
+                h.destroy();
+                return res;
+            }
+        }
+
+        std::coroutine_handle<promise_type> handle;
+    };
+
+}
+
+#endif
@@ -5,10 +5,14 @@
 #include <set>
 #include <initializer_list>
 #include <iterator>
+#include <ranges>
+#include <utility>
 
 #include "versioned.h"
 #include "revision.h"
 #include "strategy.h"
+#include "vs_snapshot.h"
+#include "persistent_set.h"
 
 namespace vs
 {
@@ -22,21 +26,25 @@ namespace vs
 	 *  @param _Key  Type of key objects.
 	 *  @param _Comp  Comparison function object type, defaults to less<_Key>.
 	 *  @param _Strategy  Custom strategy class for different merge behaviour
+	 *  @param _Set  Set that holds one version, std::set or persistent_set.
+	 *  persistent_set shares nodes between versions, so first write in
+	 *  a segment costs O(log n) new nodes instead of a full copy.
 	 */
 	template<typename _Key, typename _Comp = std::less<_Key>, 
-		typename _Strategy = vs_set_strategy<_Key, _Comp>>
+		typename _Strategy = vs_set_strategy<_Key, _Comp>,
+		typename _Set = std::set<_Key, _Comp>>
 	class vs_set
 	{
 
-	static_assert(vs::IsMergeStrategy<_Strategy, std::set<_Key, _Comp>>, 
+	static_assert(vs::IsMergeStrategy<_Strategy, _Set>, 
 		"Provided invalid strategy class in template");
 
 	public:
 	/* public typedefs */
 
-	typedef Versioned<std::set<_Key, _Comp>, _Strategy> _Versioned;
-	typedef std::set<_Key, _Comp>::iterator iterator;
-	typedef std::set<_Key, _Comp>::size_type size_type;
+	typedef Versioned<_Set, _Strategy> _Versioned;
+	typedef _Set::iterator iterator;
+	typedef _Set::size_type size_type;
 
 	private:
 
@@ -51,7 +59,7 @@ namespace vs
 	 */
 	explicit
 	vs_set(const _Comp& __comp = _Comp())
-	: _v_s(std::set<_Key, _Comp>(__comp)) { }
+	: _v_s(_Set(__comp)) { }
 
 	/**
 	 * @brief  Builds a vs_set from an initializer_list.
@@ -63,7 +71,7 @@ namespace vs
 	 */
 	vs_set(std::initializer_list<_Key> __l,
 		   const _Comp& __comp = _Comp())
-	: _v_s(std::set<_Key, _Comp>(__l, __comp)) { }
+	: _v_s(_Set(__l, __comp)) { }
 
 	/**
 	 * @brief  vs_set copy constructor
@@ -73,9 +81,27 @@ namespace vs
 	vs_set(const vs_set& __vs_set)
 	: _v_s(__vs_set._v_s.Get()) { }
 
-	//*  @brief %Set move constructor
+	/**
+	 * @brief  vs_set move constructor
+	 *
+	 * does not inherit versions history, current version of __vs_set
+	 * is moved instead of copied if it was written in current segment
+	 */
+	vs_set(vs_set&& __vs_set)
+	: _v_s(std::move(__vs_set._v_s)) { }
 
-	//*  @brief  Builds a %set from a range.
+	/**
+	 * @brief  Builds a vs_set from a range.
+	 * @param  __first  An input iterator.
+	 * @param  __last  An input iterator.
+	 * @param  __comp  Comparator to use.
+	 *
+	 * Only one version gets added. Sorted range is built in linear time.
+	 */
+	template<typename _InputIterator>
+	vs_set(_InputIterator __first, _InputIterator __last,
+		   const _Comp& __comp = _Comp())
+	: _v_s(_Set(__first, __last, __comp)) { }
 
 
 	/* ------------------ Accessors ----------------------*/
@@ -110,6 +136,17 @@ namespace vs
 	size() const noexcept
 	{ return _v_s.Get().size(); }
 
+	/**
+	 * @brief read-only snapshot of the vs_set
+	 *
+	 * Freezes the current state: later changes in this Revision, joins
+	 * and merges are not seen through the snapshot, and it can be read
+	 * from any thread. The vs_set must outlive the snapshot.
+	 */
+	vs::snapshot<_Set>
+	snapshot() const
+	{ return vs::snapshot<_Set>(_v_s); }
+
 	/**
 	 * @brief check if element is contained in set
 	 */
@@ -130,8 +167,6 @@ namespace vs
 	/* ------------------ Operators ----------------------*/
 
 	/* XXX: add pair<iteraror as in stl> */
-	/* XXX: move insert */
-
 	/**
 	 * @brief Attempts to insert an element into the %set.
 	 * @param  __x  Element to be inserted.
@@ -143,9 +178,83 @@ namespace vs
 	bool
 	insert(const _Key& __x)
 	{
-		return _v_s.Set(_v_s.Get(), [&](std::set<_Key, _Comp>& _set){return _set.insert(__x).second;});
+		return _v_s.Update([&](_Set& _set){return _set.insert(__x).second;});
+	}
+
+	/**
+	 * @brief Attempts to move an element into the %set.
+	 * @param  __x  Element to be inserted.
+	 * @return  true if element was inserted
+	 */
+	bool
+	insert(_Key&& __x)
+	{
+		return _v_s.Update([&](_Set& _set){return _set.insert(std::move(__x)).second;});
+	}
+
+	/**
+	 * @brief Attempts to build an element in the %set.
+	 * @param  __args  Arguments for the element constructor.
+	 * @return  true if element was inserted
+	 */
+	template<typename... _Args>
+	bool
+	emplace(_Args&&... __args)
+	{
+		return _v_s.Update([&](_Set& _set){return _set.emplace(std::forward<_Args>(__args)...).second;});
+	}
+
+	/**
+	 * @brief Inserts elements of a range in one versioned write.
+	 * @param  __first  An input iterator.
+	 * @param  __last  An input iterator.
+	 *
+	 * Sorted range is inserted in linear time, hinted by std::set or
+	 * merged with persistent_set.
+	 */
+	template<typename _InputIterator>
+	void
+	insert(_InputIterator __first, _InputIterator __last)
+	{
+		if (__first == __last)
+			return;
+
+		_v_s.Update([&](_Set& _set){ _set.insert(__first, __last); return true; });
+	}
+
+	/**
+	 * @brief Inserts elements of a range in one versioned write.
+	 * @param  __rg  Range of elements to be inserted.
+	 */
+	template<std::ranges::input_range _Range>
+	void
+	insert_range(_Range&& __rg)
+	{
+		auto __common = std::forward<_Range>(__rg) | std::views::common;
+		insert(std::ranges::begin(__common), std::ranges::end(__common));
+	}
+	/**
+	 * @brief  vs_set copy assignment
+	 *
+	 * Current version of __vs_set becomes a new version of this one.
+	 */
+	vs_set&
+	operator=(const vs_set& __vs_set)
+	{
+		if (this != &__vs_set)
+			_v_s.Set(__vs_set._v_s.Get());
+		return *this;
+	}
+
+	/**
+	 * @brief  vs_set move assignment
+	 */
+	vs_set&
+	operator=(vs_set&& __vs_set)
+	{
+		_v_s = std::move(__vs_set._v_s);
+		return *this;
 	}
-	// = (copy)
 	// = {}
 	};
 
@@ -158,18 +267,22 @@ namespace vs
 	 * 
 	 * Merge_same_element is empty, user is expected to override it for actually
 	 * merging same elements.
+	 *
+	 * Works with any _Set backend that vs_set accepts.
 	 */
 	template<typename _Key, typename _Comp>
 	class vs_set_strategy
 	{
 	public:
 
+	template<typename _Set>
 	void
-	merge(std::set<_Key, _Comp>& dst, std::set<_Key, _Comp>& src)
+	merge(_Set& dst, _Set& src)
 	{
 		for (auto& i: src)
 		{
-			auto found = dst.find(i);
+			/* owning find would copy every node both sides share */
+			auto found = std::as_const(dst).find(i);
 			/* XXX: dirty const_cast, but it is not used as const anyway */
 			if (found != dst.end())
 				merge_same_element(dst, const_cast<_Key&>(*found), const_cast<_Key&>(i));
@@ -178,8 +291,9 @@ namespace vs
 		}
 	}
 
+	template<typename _Set>
 	void
-	merge_same_element(std::set<_Key, _Comp>& dst, _Key& dstk, _Key& srck)
+	merge_same_element(_Set& dst, _Key& dstk, _Key& srck)
 	{
 		/* do nothing, as insert would handle it */
 	}
@@ -0,0 +1,98 @@
+#ifndef _VS_SNAPSHOT_H
+#define _VS_SNAPSHOT_H
+
+#include <memory>
+#include <utility>
+#include "revision.h"
+#include "segment.h"
+#include "versioned.h"
+
+namespace vs {
+
+    /**
+     * @brief Read-only view of a Versioned object frozen in time
+     *
+     * Holds the value the object had in the Revision that took the
+     * snapshot, and pins the Segment it was visible from, so that value
+     * is not changed or freed by later writes, joins or collapses in that
+     * Revision. Value is resolved once, accesses are plain pointer reads
+     * from any thread, with no Revision needed. Dropping a snapshot only
+     * releases the pinned Segment; its versions are folded by the next
+     * collapse of the Revision.
+     *
+     * Versioned object itself must outlive its snapshots.
+     *
+     * @tparam T Type of the object
+     */
+    template <class T>
+    class snapshot {
+    public:
+        /**
+         * @brief Empty snapshot
+         */
+        snapshot() = default;
+
+        /**
+         * @brief Take snapshot of the object in the current Revision
+         *
+         * @param var Versioned object
+         */
+        template <class _Strategy>
+        explicit snapshot(const Versioned<T, _Strategy>& var)
+        : value(&var.Get()), segment(PinRevision()) { }
+
+        /**
+         * @brief Pin the same Segment once more
+         */
+        snapshot(const snapshot& other)
+        : value(other.value), segment(other.segment) {
+            if (segment)
+                segment->refcount.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        snapshot(snapshot&& other) noexcept
+        : value(std::exchange(other.value, nullptr)), segment(std::move(other.segment)) { }
+
+        snapshot& operator=(snapshot other) noexcept {
+            std::swap(value, other.value);
+            std::swap(segment, other.segment);
+            return *this;
+        }
+
+        ~snapshot() {
+            reset();
+        }
+
+        /**
+         * @brief Unpin the Segment, snapshot becomes empty
+         */
+        void reset() {
+            if (segment)
+                segment->Release();
+            segment = nullptr;
+            value = nullptr;
+        }
+
+        const T& get() const { return *value; }
+
+        const T& operator*() const { return *value; }
+
+        const T* operator->() const { return value; }
+
+        explicit operator bool() const { return value != nullptr; }
+
+        /**
+         * @brief Iterators of the frozen value, if it is a container
+         */
+        auto begin() const requires requires(const T& t) { t.begin(); } { return value->begin(); }
+
+        auto end() const requires requires(const T& t) { t.end(); } { return value->end(); }
+
+    private:
+        const T* value = nullptr;
+        std::shared_ptr<Segment> segment;
+    };
+
+}
+
+#endif
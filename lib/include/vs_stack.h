@@ -5,10 +5,14 @@
 #include <stack>
 #include <initializer_list>
 #include <iterator>
+#include <ranges>
+#include <utility>
 
 #include "versioned.h"
 #include "revision.h"
 #include "strategy.h"
+#include "vs_snapshot.h"
+#include "persistent_stack.h"
 
 namespace vs
 {
@@ -21,19 +25,23 @@ namespace vs
 	 *
 	 *  @param _Key  Type of key objects.
 	 *  @param _Strategy  Custom strategy class for different merge behaviour
+	 *  @param _Stack  Stack that holds one version, std::stack or
+	 *  persistent_stack. persistent_stack shares frames between versions,
+	 *  so a fork copies nothing.
 	 */
-	template<typename _Key, typename _Strategy = vs_stack_strategy<_Key>>
+	template<typename _Key, typename _Strategy = vs_stack_strategy<_Key>,
+		typename _Stack = std::stack<_Key>>
 	class vs_stack
 	{
 
-	static_assert(vs::IsMergeStrategy<_Strategy, std::stack<_Key>>, 
+	static_assert(vs::IsMergeStrategy<_Strategy, _Stack>, 
 		"Provided invalid strategy class in template");
 
 	public:
 	/* public typedefs */
 
-	typedef Versioned<std::stack<_Key>,_Strategy> _Versioned;
-	typedef std::stack<_Key>::size_type size_type;
+	typedef Versioned<_Stack,_Strategy> _Versioned;
+	typedef _Stack::size_type size_type;
 
 	private:
 
@@ -47,7 +55,7 @@ namespace vs
 	 */
 	explicit
 	vs_stack()
-	: _v_s(std::stack<_Key>()) { }
+	: _v_s(_Stack()) { }
 
 	/**
 	 * @brief  Builds a vs_stack from an initializer_list.
@@ -58,10 +66,9 @@ namespace vs
 	 * Non-standard, but handy to have instead of copying with stack{{initilizer}}
 	 */
 	vs_stack(std::initializer_list<_Key> __l)
-	: _v_s(std::stack<_Key>()) 
+	: _v_s(_Stack()) 
 	{
-		_v_s.Set(_v_s.Get(),
-		[&](std::stack<_Key>& _stack){
+		_v_s.Update([&](_Stack& _stack){
 			for (auto& i: __l){
 				_stack.push(i);
 			}
@@ -77,9 +84,29 @@ namespace vs
 	vs_stack(const vs_stack& __vs_stack)
 	: _v_s(__vs_stack._v_s.Get()) { }
 
-	//*  @brief %stack move constructor
+	/**
+	 * @brief  vs_stack move constructor
+	 *
+	 * does not inherit versions history, current version of __vs_stack
+	 * is moved instead of copied if it was written in current segment
+	 */
+	vs_stack(vs_stack&& __vs_stack)
+	: _v_s(std::move(__vs_stack._v_s)) { }
 
-	//*  @brief  Builds a %stack from a range.
+	/**
+	 * @brief  Builds a vs_stack from a range.
+	 * @param  __first  An input iterator.
+	 * @param  __last  An input iterator.
+	 *
+	 * Elements are pushed in order of the range, only one version gets
+	 * added.
+	 */
+	template<typename _InputIterator>
+	vs_stack(_InputIterator __first, _InputIterator __last)
+	: _v_s(_Stack())
+	{
+		push(__first, __last);
+	}
 
 	/* ------------------ Accessors ----------------------*/
 
@@ -100,6 +127,17 @@ namespace vs
 	size() const noexcept
 	{ return _v_s.Get().size(); }
 
+	/**
+	 * @brief read-only snapshot of the vs_stack
+	 *
+	 * Freezes the current state: later changes in this Revision, joins
+	 * and merges are not seen through the snapshot, and it can be read
+	 * from any thread. The vs_stack must outlive the snapshot.
+	 */
+	vs::snapshot<_Stack>
+	snapshot() const
+	{ return vs::snapshot<_Stack>(_v_s); }
+
 	/* ------------------ Operators ----------------------*/
 
 	/**
@@ -109,7 +147,60 @@ namespace vs
 	void
 	push(const _Key& __x)
 	{
-		_v_s.Set(_v_s.Get(), [&](std::stack<_Key>& _stack){ _stack.push(__x); return true; });
+		_v_s.Update([&](_Stack& _stack){ _stack.push(__x); return true; });
+	}
+
+	/**
+	 * @brief Moves an element into the stack.
+	 * @param  __x  Element to be inserted.
+	 */
+	void
+	push(_Key&& __x)
+	{
+		_v_s.Update([&](_Stack& _stack){ _stack.push(std::move(__x)); return true; });
+	}
+
+	/**
+	 * @brief Builds an element on top of the stack.
+	 * @param  __args  Arguments for the element constructor.
+	 */
+	template<typename... _Args>
+	void
+	emplace(_Args&&... __args)
+	{
+		_v_s.Update([&](_Stack& _stack){ _stack.emplace(std::forward<_Args>(__args)...); return true; });
+	}
+
+	/**
+	 * @brief Pushes elements of a range in one versioned write.
+	 * @param  __first  An input iterator.
+	 * @param  __last  An input iterator.
+	 */
+	template<typename _InputIterator>
+	void
+	push(_InputIterator __first, _InputIterator __last)
+	{
+		if (__first == __last)
+			return;
+
+		_v_s.Update([&](_Stack& _stack){
+			for (; __first != __last; ++__first){
+				_stack.push(*__first);
+			}
+			return true;
+		});
+	}
+
+	/**
+	 * @brief Pushes elements of a range in one versioned write.
+	 * @param  __rg  Range of elements to be pushed.
+	 */
+	template<std::ranges::input_range _Range>
+	void
+	push_range(_Range&& __rg)
+	{
+		auto __common = std::forward<_Range>(__rg) | std::views::common;
+		push(std::ranges::begin(__common), std::ranges::end(__common));
 	}
 
 	/**
@@ -119,9 +210,30 @@ namespace vs
 	pop()
 	{
 		if (_v_s.Get().size() > 0)
-			_v_s.Set(_v_s.Get(), [](std::stack<_Key>& _stack){ _stack.pop(); return true; });
+			_v_s.Update([](_Stack& _stack){ _stack.pop(); return true; });
+	}
+	/**
+	 * @brief  vs_stack copy assignment
+	 *
+	 * Current version of __vs_stack becomes a new version of this one.
+	 */
+	vs_stack&
+	operator=(const vs_stack& __vs_stack)
+	{
+		if (this != &__vs_stack)
+			_v_s.Set(__vs_stack._v_s.Get());
+		return *this;
+	}
+
+	/**
+	 * @brief  vs_stack move assignment
+	 */
+	vs_stack&
+	operator=(vs_stack&& __vs_stack)
+	{
+		_v_s = std::move(__vs_stack._v_s);
+		return *this;
 	}
-	// = (copy)
 	// = {}
 	};
 
@@ -131,14 +243,17 @@ namespace vs
 	 * On merge, puts everything from one stack to other. It is expected to
 	 * start with empty stacks and merge remainders, or for user to override
 	 * this strategy.
+	 *
+	 * Works with any _Stack backend that vs_stack accepts.
 	 */
 	template<typename _Key>
 	class vs_stack_strategy
 	{
 	public:
 
+	template<typename _Stack>
 	void
-	merge(std::stack<_Key>& dst, std::stack<_Key>& src)
+	merge(_Stack& dst, _Stack& src)
 	{
 		while (src.size() > 0)
 		{
@@ -147,17 +262,46 @@ namespace vs
 		}
 	}
 
+	template<typename _Stack>
 	void
-	merge_same_element(std::stack<_Key>& dst, _Key& dstk, _Key& srck)
+	merge_same_element(_Stack& dst, _Key& dstk, _Key& srck)
 	{
 		dst.push(srck);
 	}
 
 	};
 
+	/**
+	 * @brief merge strategy that keeps both sides' frames, persistent_stack only
+	 *
+	 * Frames that child has above the deepest frame it still shares with
+	 * parent are pushed onto the parent in the same order, without the
+	 * reversal done by vs_stack_strategy. Shared frames are found by node
+	 * identity, so join costs O(new frames) instead of O(size). If parent
+	 * did not touch the stack since fork, it just takes the child's stack.
+	 */
 	template<typename _Key>
-	std::ostream& operator << (std::ostream& os, vs_stack<_Key> const& value) {
-		vs_stack<_Key> temp = value;
+	class vs_stack_splice_strategy
+	{
+	public:
+
+	void
+	merge(persistent_stack<_Key>& dst, persistent_stack<_Key>& src)
+	{
+		dst.splice(src);
+	}
+
+	void
+	merge_same_element(persistent_stack<_Key>& dst, _Key& dstk, _Key& srck)
+	{
+		dst.push(srck);
+	}
+
+	};
+
+	template<typename _Key, typename _Strategy, typename _Stack>
+	std::ostream& operator << (std::ostream& os, vs_stack<_Key, _Strategy, _Stack> const& value) {
+		vs_stack<_Key, _Strategy, _Stack> temp = value;
 		std::stack<_Key> reversedStack;
 
 		while (temp.size() != 0) {
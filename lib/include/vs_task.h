@@ -0,0 +1,299 @@
+#ifndef _VS_TASK_H
+#define _VS_TASK_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include "pool_allocator.h"
+#include "revision.h"
+#include "segment.h"
+
+namespace vs {
+
+    /* internal class */
+
+    /**
+     * @brief Anything that can be queued to the WorkerPool
+     */
+    struct Job {
+        virtual ~Job() = default;
+
+        /**
+         * @brief Do the work, called once by some worker or joiner
+         */
+        virtual void run() = 0;
+    };
+
+    /* internal class */
+
+    /**
+     * @brief Work of one task together with the Revision it runs in
+     */
+    struct TaskState : Job {
+        /**
+         * @brief Run the work in its Revision and mark task done
+         *
+         * Revision of the calling thread is restored afterwards, as
+         * workers and joiners run many tasks one after another.
+         */
+        void run() override;
+
+        /**
+         * @brief Revision of the task
+         */
+        std::shared_ptr<Revision> revision;
+
+        /**
+         * @brief Exception thrown by the work, rethrown in join
+         */
+        std::exception_ptr error;
+
+        /**
+         * @brief Set when the work is finished
+         */
+        std::atomic<bool> done = false;
+
+    protected:
+        virtual void invoke() = 0;
+    };
+
+    /* internal class */
+
+    /**
+     * @brief TaskState of particular function and its arguments
+     */
+    template <typename Function, typename... Args>
+    struct TaskImpl : TaskState {
+        TaskImpl(Function&& f, Args&&... args)
+        : f(std::forward<Function>(f)), args(std::forward<Args>(args)...) { }
+
+        void invoke() override { std::apply(std::move(f), std::move(args)); }
+
+        std::decay_t<Function> f;
+        std::tuple<std::decay_t<Args>...> args;
+    };
+
+    /* internal class */
+
+    /**
+     * @brief Fixed set of threads, each with its own deque of tasks
+     *
+     * Workers push tasks they spawn to the back of their own deque and
+     * take from there, so nested work stays on the same thread. Idle
+     * workers steal from the front of other deques. Tasks spawned outside
+     * of the pool are spread between workers.
+     */
+    class WorkerPool {
+    public:
+        /**
+         * @brief Pool shared by all tasks, started on first use
+         *
+         * Has one worker per hardware thread.
+         */
+        static WorkerPool& instance();
+
+        explicit WorkerPool(std::size_t workers);
+        ~WorkerPool();
+
+        WorkerPool(const WorkerPool&) = delete;
+        WorkerPool& operator=(const WorkerPool&) = delete;
+
+        /**
+         * @brief Queue job for execution
+         */
+        void submit(std::shared_ptr<Job> job);
+
+        /**
+         * @brief Run one queued job in the calling thread, if there is any
+         *
+         * @return bool true if some job was run
+         */
+        bool runOne();
+
+        /**
+         * @brief Run f(0) .. f(n - 1) on the pool and wait for all of them
+         *
+         * Calling thread runs f(0) itself and helps with the rest. The
+         * first exception thrown by f is rethrown once all calls are done.
+         */
+        void parallelFor(std::size_t n, const std::function<void(std::size_t)>& f);
+
+        std::size_t size() const { return workers.size(); }
+
+    private:
+        struct Worker {
+            std::mutex mutex;
+            std::deque<std::shared_ptr<Job>> tasks;
+        };
+
+        /**
+         * @brief Take job from own deque or steal one from others
+         */
+        std::shared_ptr<Job> take();
+
+        void workerLoop(std::size_t index);
+
+        std::vector<std::unique_ptr<Worker>> queues;
+        std::vector<std::thread> workers;
+
+        /* queued and not yet taken tasks */
+        std::atomic<std::size_t> pending = 0;
+        std::atomic<std::size_t> nextQueue = 0;
+
+        std::mutex sleepMutex;
+        std::condition_variable sleepCv;
+        bool stop = false;
+    };
+
+    /**
+     * @brief Revision run on the shared worker pool instead of own thread
+     *
+     * Forks a Revision like vs::thread does, but the function runs on one
+     * of the pool workers, so no OS thread is created per fork. Joining
+     * merges the Revision exactly like vs::thread::join. While waiting,
+     * join runs other queued tasks, so tasks can spawn and join tasks.
+     *
+     * As with vs::thread, a task must be joined before destruction, from
+     * the Revision it was spawned in.
+     */
+    class task {
+    public:
+        task() noexcept = default;
+
+        /**
+         * @brief Forks new Revision and queues function to run in it
+         *
+         * @tparam Function - callable
+         * @tparam Args - optional arguments for function
+         * @param f - function to call
+         * @param args - args to pass to the function (optional)
+         */
+        template <typename Function, typename... Args>
+        explicit task(Function&& f, Args&&... args);
+
+        task(task&&) noexcept = default;
+
+        task& operator=(task&& other) noexcept {
+            if (joinable())
+                std::terminate();
+            state = std::move(other.state);
+            return *this;
+        }
+
+        ~task() {
+            if (joinable())
+                std::terminate();
+        }
+
+        bool joinable() const noexcept { return state != nullptr; }
+
+        /**
+         * @brief Waits for the task and joins its Revision
+         *
+         * Rethrows exception of the task function, after the join.
+         *
+         * @see Revision
+         */
+        void join();
+
+    private:
+        std::shared_ptr<TaskState> state;
+    };
+
+    /**
+     * @brief Same as constructing vs::task
+     */
+    template <typename Function, typename... Args>
+    task spawn(Function&& f, Args&&... args) {
+        return task(std::forward<Function>(f), std::forward<Args>(args)...);
+    }
+
+    /**
+     * @brief Tasks forked together and joined at once
+     *
+     * Forking many vs::task one after another puts a new Segment on the
+     * parent chain for every one of them. Tasks of a group that are run
+     * with no writes of the parent in between are all forked off the same
+     * Segment instead, so the chain doesn't grow with the group.
+     *
+     * join waits for all tasks and merges them pairwise in a reduction
+     * tree, each round of merges running on the pool in parallel, and
+     * finally merges the result into the current Revision. Later tasks
+     * are merged into earlier ones, so the result is the same as joining
+     * them one by one in order of run, as long as merge strategies are
+     * associative.
+     *
+     * Like vs::task, a group must be joined before destruction, from the
+     * Revision its tasks were run in.
+     */
+    class task_group {
+    public:
+        task_group() = default;
+
+        task_group(const task_group&) = delete;
+        task_group& operator=(const task_group&) = delete;
+
+        ~task_group() {
+            if (!tasks.empty())
+                std::terminate();
+        }
+
+        /**
+         * @brief Forks new Revision and queues function to run in it
+         *
+         * @tparam Function - callable
+         * @tparam Args - optional arguments for function
+         * @param f - function to call
+         * @param args - args to pass to the function (optional)
+         */
+        template <typename Function, typename... Args>
+        void run(Function&& f, Args&&... args);
+
+        /**
+         * @brief Waits for all tasks and joins their Revisions
+         *
+         * Rethrows the first exception of the task functions, in order of
+         * run, after the join.
+         */
+        void join();
+
+        /**
+         * @brief Number of tasks not joined yet
+         */
+        std::size_t size() const noexcept { return tasks.size(); }
+
+    private:
+        std::vector<std::shared_ptr<TaskState>> tasks;
+    };
+
+
+    template <typename Function, typename... Args>
+    void task_group::run(Function&& f, Args&&... args) {
+        auto impl = MakePooled<TaskImpl<Function, Args...>>(std::forward<Function>(f), std::forward<Args>(args)...);
+        impl->revision = tasks.empty() ? ForkRevision() : ForkRevision(*tasks.back()->revision);
+        tasks.push_back(impl);
+
+        WorkerPool::instance().submit(std::move(impl));
+    }
+
+    template <typename Function, typename... Args>
+    task::task(Function&& f, Args&&... args) {
+        auto impl = MakePooled<TaskImpl<Function, Args...>>(std::forward<Function>(f), std::forward<Args>(args)...);
+        impl->revision = ForkRevision();
+        state = std::move(impl);
+
+        WorkerPool::instance().submit(state);
+    }
+
+}
+
+#endif
@@ -22,12 +22,12 @@ namespace vs {
          * @param args - args to pass to the function (optional)
          */
         template <typename Function, typename... Args>
-        explicit thread(Function&& f, Args&&... args) : std::thread(&thread::threadFunctionWrapper<Function, Args...>, this,
-                          std::forward<Function>(f), std::forward<Args>(args)...) {
-            auto s = std::make_shared<Segment>(Revision::currentRevision->current);
-            threadRevision = std::make_shared<Revision>(Revision::currentRevision->current, s);
-            Revision::currentRevision->current->Release();
-            Revision::currentRevision->current = std::make_shared<Segment>(Revision::currentRevision->current);
+        explicit thread(Function&& f, Args&&... args) {
+            threadRevision = ForkRevision();
+
+            // Start thread only when its Revision is ready
+            std::thread::operator=(std::thread(&thread::threadFunctionWrapper<Function, Args...>, threadRevision,
+                          std::forward<Function>(f), std::forward<Args>(args)...));
         }
 
         /**
@@ -37,17 +37,7 @@ namespace vs {
          */
         void join() {
             std::thread::join();
-
-            std::shared_ptr<Segment> s = threadRevision->current;
-            while (s != threadRevision->root) {
-                for (auto v: s->written) {
-                    v->Merge(Revision::currentRevision, threadRevision, s);
-                }
-                s = s->parent;
-            }
-
-            threadRevision->current->Release();
-            Revision::currentRevision->current->Collapse(Revision::currentRevision);
+            JoinRevision(threadRevision);
         }
 
         // Don't allow to detach thread
@@ -66,11 +56,12 @@ namespace vs {
         /**
          * @brief Function that will be called in thread before passed thread function
          *
-         * @param self Needed for accessing threadRevision
+         * @param revision Revision of the new thread, passed by value
+         * because thread object can be moved before the thread starts
          */
         template <class Function, class... Args>
-        static void threadFunctionWrapper(thread* self, Function&& f, Args&&... args) {
-            Revision::currentRevision = self->threadRevision;
+        static void threadFunctionWrapper(std::shared_ptr<Revision> revision, Function&& f, Args&&... args) {
+            Revision::currentRevision = std::move(revision);
 
             std::invoke(std::forward<Function>(f), std::forward<Args>(args)...);
         }
@@ -1,150 +1,35 @@
 #ifndef _VS_TREE_H
 #define _VS_TREE_H
 
+#include <algorithm>
+#include <cstddef>
 #include <functional>
 #include <initializer_list>
 #include <iterator>
+#include <ranges>
 #include <stack>
+#include <utility>
+#include <vector>
 #include <iostream>
 #include <sstream>
 
 #include "versioned.h"
 #include "revision.h"
 #include "strategy.h"
+#include "vs_snapshot.h"
+#include "vs_tree_node.h"
 
 namespace vs
 {
 	template<typename _Key, typename _Comp>
 	class vs_tree_strategy;
 
-	/* internal class */
-
-	/**
-	 * @brief Manages all balancing logic and correlating allocations;
-	 */
-	template<typename _Key, typename _Comp = std::less<_Key>>
-	struct _vs_tree_node
-	{
-		public:
-
-		typedef _vs_tree_node<_Key, _Comp>* _Ptr_type;
-		typedef int size_type;
-
-		_Key value;
-		size_type height = 0;
-		_Ptr_type left = nullptr;
-		_Ptr_type right = nullptr;
-
-		/* ------------------ Constructors ----------------------*/
-
-		_vs_tree_node(const _Key& _value)
-		: value(_value){ }
-
-		_vs_tree_node(const _vs_tree_node& _node)
-		: value(_node.value), height(_node.height) { }
-
-		/* ------------------- Balancing ----------------------*/
-
-		void refresh_node_height()
-		{
-			size_type lh = (left ? left->height + 1 : 0);
-			size_type rh = (right ? right->height + 1 : 0);
-
-			height = (lh > rh ? lh : rh);
-		}
-
-		size_type
-		node_delta_height()
-		{
-			size_type lh = (left ? left->height + 1 : 0);
-			size_type rh = (right ? right->height + 1 : 0);
-			
-			return lh - rh;
-		}
-
-		_Ptr_type
-		rebalance()
-		{
-			refresh_node_height();
-
-			switch (node_delta_height())
-			{
-				case 2:
-					if (left->node_delta_height() < 0)
-						left = left->turnleft();
-
-					return turnright();
-
-				case -2:
-					if (right->node_delta_height() > 0)
-						right = right->turnright();
-					return turnleft();
-				
-				default:
-					return this;
-			}
-		}
-
-		_Ptr_type
-		turnleft(){
-			_Ptr_type child = right;
-			right = child->left;
-			child->left = this;
-			refresh_node_height();
-			child->refresh_node_height();
-			return child;
-		}
-
-		_Ptr_type
-		turnright(){
-			_Ptr_type child = left;
-			left = child->right;
-			child->right = this;
-			refresh_node_height();
-			child->refresh_node_height();
-			return child;
-		}
-
-		/**
-		 * @brief Fall down recursively, insert and rebalance on the way up
-		 */
-		_Ptr_type
-		node_insert(const _Key& _value, _Comp comp = _Comp{})
-		{
-			if (comp(_value, this->value))
-			{
-				if (left)
-				{
-					left = left->node_insert(_value);
-				}
-				else
-				{
-					left = new _vs_tree_node(_value);
-				}
-			}
-			else
-			{
-				if (right)
-				{
-					right = right->node_insert(_value);
-				}
-				else
-				{
-					right = new _vs_tree_node(_value);
-				}
-			}
-
-			return rebalance();
-		}
-
-	};
-
-	template<typename _Key, typename _Comp = std::less<_Key>>
+	template<typename _Key, typename _Comp = std::less<_Key>, typename _Alloc = PoolAllocator<_Key>>
 	struct _vs_tree_iterator
 	{
 		public:
 
-		typedef _vs_tree_node<_Key, _Comp>::_Ptr_type _Ptr_type;
+		typedef _vs_tree_node<_Key, _Comp, _Alloc>::_Raw_ptr_type _Ptr_type;
 
 		typedef _Key  value_type;
 		typedef _Key& reference;
@@ -153,7 +38,7 @@ namespace vs
 		typedef std::forward_iterator_tag iterator_category;
 		typedef ptrdiff_t			 difference_type;
 
-		typedef _vs_tree_iterator<_Key, _Comp> _Self;
+		typedef _vs_tree_iterator<_Key, _Comp, _Alloc> _Self;
 
 		_vs_tree_iterator()
 		: parents(), node() { }
@@ -221,18 +106,18 @@ namespace vs
 			if (node->left)
 			{
 				parents.push(node);
-				node = node->left;
+				node = node->left.get();
 			}
 			else if (node->right)
 			{
 				parents.push(node);
-				node = node->right;
+				node = node->right.get();
 			}
 			else
 			{
 				while (!parents.empty())
 				{
-					bool came_with_right = (parents.top()->right == node ? true : false);
+					bool came_with_right = (parents.top()->right.get() == node ? true : false);
 					node = parents.top();
 					if (came_with_right)
 					{
@@ -242,7 +127,7 @@ namespace vs
 
 					if (node->right)
 					{
-						node = node->right;
+						node = node->right.get();
 						break;
 					}
 					else
@@ -260,17 +145,22 @@ namespace vs
 
 	/**
 	 * @brief serves as stl-like interface from node to vs_tree; 
-	 * handles allocations in construction and destruction.
+	 * handles sharing of nodes between copies.
+	 *
+	 * Copying a tree is O(1): both copies point to the same nodes, and
+	 * each of them copies only the nodes on the path of its own inserts.
 	 */
-	template<typename _Key, typename _Comp = std::less<_Key>>
+	template<typename _Key, typename _Comp = std::less<_Key>, typename _Alloc = PoolAllocator<_Key>>
 	class _vs_tree
 	{
 		public:
 
 		/* public typedefs */
-		typedef _vs_tree_iterator<_Key, _Comp> iterator;
-		typedef _vs_tree_node<_Key, _Comp>::_Ptr_type _Ptr_type;
-		typedef _vs_tree_node<_Key, _Comp>::size_type size_type;
+		typedef _vs_tree_iterator<_Key, _Comp, _Alloc> iterator;
+		typedef _vs_tree_node<_Key, _Comp, _Alloc> _Node_type;
+		typedef _Node_type::_Ptr_type _Ptr_type;
+		typedef _Node_type::_Raw_ptr_type _Raw_ptr_type;
+		typedef _Node_type::size_type size_type;
 
 		/* needed for concept */
 		typedef _Key value_type;
@@ -282,66 +172,33 @@ namespace vs
 		size_type _height = 0;
 		size_type _size = 0;
 
-		/**
-		 * @brief tree deep-copy
-		 * 
-		 * It is a bit recursive, but it should end up fine for balanced tree
-		 * that AVL is.
-		 */
-		void
-		copy_subtree(_Ptr_type dst, _Ptr_type src)
-		{
-			if (src->left)
-			{
-				dst->left = new _vs_tree_node(*(src->left));
-				copy_subtree(dst->left, src->left);
-			}
-			if (src->right)
-			{
-				dst->right = new _vs_tree_node(*(src->right));
-				copy_subtree(dst->right, src->right);
-			}
-		}
-
-		/**
-		 * @brief destructor helper
-		 * 
-		 * It is a bit recursive, but it should end up fine for balanced tree
-		 * that AVL is.
-		 */
-		void
-		delete_subtree(_Ptr_type node)
-		{
-			if (node->left)
-				delete_subtree(node->left);
-
-			if (node->right)
-				delete_subtree(node->right);
-
-			delete node;
-		}
-
 		public:
 		/* ------------------ Constructors ----------------------*/
 
 		_vs_tree() = default;
 
-		_vs_tree(const _vs_tree& _tree)
-		{
-			if (_tree.head) {
-				this->head = new _vs_tree_node(*(_tree.head));
-				copy_subtree(this->head, _tree.head);
-			}
+		/**
+		 * @brief shares all nodes with _tree
+		 */
+		_vs_tree(const _vs_tree& _tree) = default;
 
-		}
+		_vs_tree&
+		operator=(const _vs_tree& _tree) = default;
 
-		~_vs_tree()
-		{
-			std::cout << "deleting " << this << std::endl;
-			if (head)
-				delete_subtree(head);
+		/**
+		 * @brief takes all nodes of _tree, leaving it empty
+		 */
+		_vs_tree(_vs_tree&& _tree) noexcept
+		: head(std::move(_tree.head)), _height(std::exchange(_tree._height, 0)),
+		  _size(std::exchange(_tree._size, 0)) { }
 
-			head = nullptr;
+		_vs_tree&
+		operator=(_vs_tree&& _tree) noexcept
+		{
+			head = std::move(_tree.head);
+			_height = std::exchange(_tree._height, 0);
+			_size = std::exchange(_tree._size, 0);
+			return *this;
 		}
 
 		/* ------------------ Accessors ----------------------*/
@@ -349,7 +206,7 @@ namespace vs
 		iterator
 		begin()
 		{
-			return iterator(this->head);
+			return iterator(this->head.get());
 		}
 		iterator
 		end()
@@ -360,7 +217,7 @@ namespace vs
 		iterator
 		begin() const
 		{
-			return iterator(this->head);
+			return iterator(this->head.get());
 		}
 		iterator
 		end() const
@@ -380,11 +237,30 @@ namespace vs
 		iterator
 		find(const _Key& _x) const
 		{
-			return find_subtree(_x, head);
+			if (!head)
+				return end();
+
+			return find_subtree(_x, head.get());
+		}
+
+		/**
+		 * @brief find element to modify in place
+		 *
+		 * Unlike the const version, copies shared nodes on the path to found
+		 * element, so writing through the iterator does not leak into other
+		 * versions of the tree.
+		 */
+		iterator
+		find(const _Key& _x)
+		{
+			if (!head || std::as_const(*this).find(_x) == end())
+				return end();
+
+			return find_own_subtree(_x, head);
 		}
 
 		iterator
-		find_subtree(const _Key& _x, const _Ptr_type& node, _Comp comp = _Comp{}) const
+		find_subtree(const _Key& _x, _Raw_ptr_type node, _Comp comp = _Comp{}) const
 		{
 			if (node->value == _x)
 				return iterator(node);
@@ -392,14 +268,14 @@ namespace vs
 			if (comp(_x, node->value))
 			{
 				if (node->left)
-					return find_subtree(_x, node->left);
+					return find_subtree(_x, node->left.get());
 				else
 					return end();
 			}
 			else
 			{
 				if (node->right)
-					return find_subtree(_x, node->right);
+					return find_subtree(_x, node->right.get());
 				else
 					return end();
 			}
@@ -417,14 +293,57 @@ namespace vs
 
 		void 
 		push(const _Key& _value)
+		{ push_value(_value); }
+
+		void
+		push(_Key&& _value)
+		{ push_value(std::move(_value)); }
+
+		template<typename... _Args>
+		void
+		emplace(_Args&&... __args)
+		{ push_value(_Key(std::forward<_Args>(__args)...)); }
+
+		/**
+		 * @brief push elements of a range
+		 *
+		 * Sorted range that is not smaller than the tree is merged with it
+		 * and built anew in linear time, instead of log time per element.
+		 * Nodes of the tree are not shared then with its copies.
+		 */
+		template<typename _InputIterator>
+		void
+		push(_InputIterator __first, _InputIterator __last)
 		{
-			if (head)
-				head = head->node_insert(_value);
-			else
-				head = new _vs_tree_node<_Key, _Comp>(_value);
+			std::vector<_Key> values(__first, __last);
+			_Comp comp{};
 
-			_height = head->height + 1;
-			_size++;
+			if (values.size() < static_cast<std::size_t>(_size) ||
+				!std::is_sorted(values.begin(), values.end(), comp))
+			{
+				for (auto& i: values)
+					push(i);
+				return;
+			}
+
+			if (_size)
+			{
+				std::vector<_Key> old;
+				old.reserve(_size);
+				_Node_type::collect_sorted(head.get(), old);
+
+				/* equal elements already in the tree go first, as in push */
+				std::vector<_Key> all;
+				all.reserve(old.size() + values.size());
+				std::merge(old.begin(), old.end(), values.begin(), values.end(),
+					std::back_inserter(all), comp);
+				values = std::move(all);
+			}
+
+			auto it = values.cbegin();
+			head = _Node_type::build_sorted(it, values.size());
+			_height = head ? head->height + 1 : 0;
+			_size = values.size();
 		}
 
 		// void
@@ -438,30 +357,64 @@ namespace vs
 		// 	}
 		// }
 
+		private:
+
+		template<typename _Arg>
+		void
+		push_value(_Arg&& _value)
+		{
+			if (head)
+				_Node_type::node_insert(head, std::forward<_Arg>(_value));
+			else
+				head = _Node_type::create(std::forward<_Arg>(_value));
+
+			_height = head->height + 1;
+			_size++;
+		}
+
+		/**
+		 * @brief same walk as find_subtree, but owning nodes on the way
+		 */
+		iterator
+		find_own_subtree(const _Key& _x, _Ptr_type& slot, _Comp comp = _Comp{})
+		{
+			_Ptr_type& node = _Node_type::own(slot);
+
+			if (node->value == _x)
+				return iterator(node.get());
+
+			if (comp(_x, node->value))
+				return find_own_subtree(_x, node->left);
+			else
+				return find_own_subtree(_x, node->right);
+		}
+
 	};
 
 	/* TODO: add param _Strategy */
 
 	/**
-	 *  @brief A versioned AVL-tree with deep copy constructor in internal classes
+	 *  @brief A versioned persistent AVL-tree, versions share untouched nodes
 	 *
 	 *  @param _Key  Type of key objects.
 	 *  @param _Comp  Comparison function object type, defaults to less<_Key>.
 	 *  @param _Strategy  Custom strategy class for different merge behaviour
+	 *  @param _Alloc  Allocator policy for tree nodes, defaults to per-thread pools
 	 */
-	template<typename _Key, typename _Comp = std::less<_Key>, typename _Strategy = vs_tree_strategy<_Key, _Comp>>
+	template<typename _Key, typename _Comp = std::less<_Key>, typename _Strategy = vs_tree_strategy<_Key, _Comp>,
+		typename _Alloc = PoolAllocator<_Key>>
 	class vs_tree
 	{
 
-	static_assert(vs::IsMergeStrategy<_Strategy, _vs_tree<_Key, _Comp>>, 
+	static_assert(vs::IsMergeStrategy<_Strategy, _vs_tree<_Key, _Comp, _Alloc>>, 
 	"Provided invalid strategy class in template");
 
 	public:
 	/* public typedefs */
 
-	typedef Versioned<_vs_tree<_Key, _Comp>, _Strategy> _Versioned;
-	typedef _vs_tree<_Key, _Comp>::iterator iterator;
-	typedef _vs_tree<_Key, _Comp>::size_type size_type;
+	typedef Versioned<_vs_tree<_Key, _Comp, _Alloc>, _Strategy> _Versioned;
+	typedef _vs_tree<_Key, _Comp, _Alloc>::iterator iterator;
+	typedef _vs_tree<_Key, _Comp, _Alloc>::size_type size_type;
 
 	private:
 
@@ -476,7 +429,7 @@ namespace vs
 	 */
 	explicit
 	vs_tree(const _Comp& __comp = _Comp())
-	: _v_t(_vs_tree<_Key, _Comp>()) { }
+	: _v_t(_vs_tree<_Key, _Comp, _Alloc>()) { }
 
 	/**
 	 * @brief  Builds a vs_tree from an initializer_list.
@@ -488,10 +441,9 @@ namespace vs
 	 */
 	vs_tree(std::initializer_list<_Key> __l,
 		   const _Comp& __comp = _Comp())
-	: _v_t(_vs_tree<_Key, _Comp>())
+	: _v_t(_vs_tree<_Key, _Comp, _Alloc>())
 	{
-		_v_t.Set(_v_t.Get(),
-		[&](_vs_tree<_Key, _Comp>& _tree){
+		_v_t.Update([&](_vs_tree<_Key, _Comp, _Alloc>& _tree){
 			for (auto& i: __l){
 				_tree.push(i);
 			}
@@ -507,9 +459,30 @@ namespace vs
 	vs_tree(const vs_tree& __vs_tree)
 	: _v_t(__vs_tree._v_t.Get()) { }
 
-	//*  @brief tree move constructor
+	/**
+	 * @brief  vs_tree move constructor
+	 *
+	 * does not inherit versions history, current version of __vs_tree
+	 * is moved instead of copied if it was written in current segment
+	 */
+	vs_tree(vs_tree&& __vs_tree)
+	: _v_t(std::move(__vs_tree._v_t)) { }
 
-	//*  @brief  Builds a tree from a range.
+	/**
+	 * @brief  Builds a vs_tree from a range.
+	 * @param  __first  An input iterator.
+	 * @param  __last  An input iterator.
+	 * @param  __comp  Comparator to use.
+	 *
+	 * Only one version gets added. Sorted range is built in linear time.
+	 */
+	template<typename _InputIterator>
+	vs_tree(_InputIterator __first, _InputIterator __last,
+		   const _Comp& __comp = _Comp())
+	: _v_t(_vs_tree<_Key, _Comp, _Alloc>())
+	{
+		push(__first, __last);
+	}
 
 
 	/* ------------------ Accessors ----------------------*/
@@ -541,6 +514,17 @@ namespace vs
 	size() const noexcept
 	{ return _v_t.Get().size(); }
 
+	/**
+	 * @brief read-only snapshot of the vs_tree
+	 *
+	 * Freezes the current state: later changes in this Revision, joins
+	 * and merges are not seen through the snapshot, and it can be read
+	 * from any thread. The vs_tree must outlive the snapshot.
+	 */
+	vs::snapshot<_vs_tree<_Key, _Comp, _Alloc>>
+	snapshot() const
+	{ return vs::snapshot<_vs_tree<_Key, _Comp, _Alloc>>(_v_t); }
+
 	/**
 	 * @brief height of underlying tree
 	 */
@@ -557,8 +541,6 @@ namespace vs
 
 	/* ------------------ Operators ----------------------*/
 
-	/* XXX: move insert */
-
 	/**
 	 * @brief Attempts to insert an element into the vs_tree.
 	 * @param  __x  Element to be inserted.
@@ -566,9 +548,81 @@ namespace vs
 	void
 	push(const _Key& __x)
 	{
-		_v_t.Set(_v_t.Get(), [&](_vs_tree<_Key, _Comp>& _tree){_tree.push(__x); return true;});
+		_v_t.Update([&](_vs_tree<_Key, _Comp, _Alloc>& _tree){_tree.push(__x); return true;});
+	}
+
+	/**
+	 * @brief Moves an element into the vs_tree.
+	 * @param  __x  Element to be inserted.
+	 */
+	void
+	push(_Key&& __x)
+	{
+		_v_t.Update([&](_vs_tree<_Key, _Comp, _Alloc>& _tree){_tree.push(std::move(__x)); return true;});
+	}
+
+	/**
+	 * @brief Builds an element in the vs_tree.
+	 * @param  __args  Arguments for the element constructor.
+	 */
+	template<typename... _Args>
+	void
+	emplace(_Args&&... __args)
+	{
+		_v_t.Update([&](_vs_tree<_Key, _Comp, _Alloc>& _tree){_tree.emplace(std::forward<_Args>(__args)...); return true;});
+	}
+
+	/**
+	 * @brief Inserts elements of a range in one versioned write.
+	 * @param  __first  An input iterator.
+	 * @param  __last  An input iterator.
+	 *
+	 * Sorted range that is not smaller than the tree is merged with it
+	 * in linear time.
+	 */
+	template<typename _InputIterator>
+	void
+	push(_InputIterator __first, _InputIterator __last)
+	{
+		if (__first == __last)
+			return;
+
+		_v_t.Update([&](_vs_tree<_Key, _Comp, _Alloc>& _tree){_tree.push(__first, __last); return true;});
+	}
+
+	/**
+	 * @brief Inserts elements of a range in one versioned write.
+	 * @param  __rg  Range of elements to be inserted.
+	 */
+	template<std::ranges::input_range _Range>
+	void
+	push_range(_Range&& __rg)
+	{
+		auto __common = std::forward<_Range>(__rg) | std::views::common;
+		push(std::ranges::begin(__common), std::ranges::end(__common));
+	}
+	/**
+	 * @brief  vs_tree copy assignment
+	 *
+	 * Current version of __vs_tree becomes a new version of this one.
+	 */
+	vs_tree&
+	operator=(const vs_tree& __vs_tree)
+	{
+		if (this != &__vs_tree)
+			_v_t.Set(__vs_tree._v_t.Get());
+		return *this;
+	}
+
+	/**
+	 * @brief  vs_tree move assignment
+	 */
+	vs_tree&
+	operator=(vs_tree&& __vs_tree)
+	{
+		_v_t = std::move(__vs_tree._v_t);
+		return *this;
 	}
-	// = (copy)
 	// = {}
 	};
 
@@ -584,12 +638,17 @@ namespace vs
 	{
 	public:
 
+	template<typename _Tree>
 	void
-	merge(_vs_tree<_Key, _Comp>& dst, _vs_tree<_Key, _Comp>& src)
+	merge(_Tree& dst, _Tree& src)
 	{
 		for (auto& i: src)
 		{
-			auto found = dst.find(i);
+			/*
+			 * owning find copies the path to every element both sides
+			 * share, strategies writing to dstk have to use it instead
+			 */
+			auto found = std::as_const(dst).find(i);
 			if (found != dst.end())
 				merge_same_element(dst, *found, i);
 			else
@@ -597,17 +656,18 @@ namespace vs
 		}
 	}
 
+	template<typename _Tree>
 	void
-	merge_same_element(_vs_tree<_Key, _Comp>& dst, _Key& dstk, _Key& srck)
+	merge_same_element(_Tree& dst, _Key& dstk, _Key& srck)
 	{
 		/* pretend we didnt saw new elements */
 	}
 
 	};
 
-	template<typename _Key, typename _Comp>
-	std::ostream& operator << (std::ostream& os, vs_tree<_Key,_Comp> const& value) {
-		vs_tree<_Key,_Comp> temp = value;
+	template<typename _Key, typename _Comp, typename _Strategy, typename _Alloc>
+	std::ostream& operator << (std::ostream& os, vs_tree<_Key,_Comp,_Strategy,_Alloc> const& value) {
+		vs_tree<_Key,_Comp,_Strategy,_Alloc> temp = value;
 
 		std::ostringstream o;
 		o << "{ ";
@@ -0,0 +1,231 @@
+#ifndef _VS_TREE_NODE_H
+#define _VS_TREE_NODE_H
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "pool_allocator.h"
+
+namespace vs
+{
+	/* internal class */
+
+	/**
+	 * @brief Manages all balancing logic and correlating allocations;
+	 *
+	 * Nodes are persistent: versions of a tree share every subtree they
+	 * did not change. A node that is reachable from more than one place is
+	 * never modified, it is copied first (see own()), so an insert copies
+	 * only the nodes on its path and leaves sibling versions intact.
+	 *
+	 * Nodes are allocated together with their control blocks by _Alloc,
+	 * which is default-constructed for every node. Default one takes them
+	 * from per-thread pools, so nodes of a tree built by one thread are
+	 * packed together, and freeing a tree version takes no locks.
+	 */
+	template<typename _Key, typename _Comp = std::less<_Key>, typename _Alloc = PoolAllocator<_Key>>
+	struct _vs_tree_node
+	{
+		public:
+
+		typedef std::shared_ptr<_vs_tree_node<_Key, _Comp, _Alloc>> _Ptr_type;
+		typedef _vs_tree_node<_Key, _Comp, _Alloc>* _Raw_ptr_type;
+		typedef int size_type;
+
+		_Key value;
+		size_type height = 0;
+		_Ptr_type left = nullptr;
+		_Ptr_type right = nullptr;
+
+		/* ------------------ Constructors ----------------------*/
+
+		_vs_tree_node(const _Key& _value)
+		: value(_value){ }
+
+		_vs_tree_node(_Key&& _value)
+		: value(std::move(_value)){ }
+
+		/**
+		 * @brief shallow copy, children are shared with original node
+		 */
+		_vs_tree_node(const _vs_tree_node& _node)
+		: value(_node.value), height(_node.height),
+		  left(_node.left), right(_node.right) { }
+
+		/**
+		 * @brief allocate node with _Alloc
+		 */
+		template<typename... _Args>
+		static _Ptr_type
+		create(_Args&&... __args)
+		{
+			return std::allocate_shared<_vs_tree_node>(_Alloc(), std::forward<_Args>(__args)...);
+		}
+
+		/* ------------------- Sharing ----------------------*/
+
+		/**
+		 * @brief make node in slot safe to modify in place
+		 *
+		 * Node owned only by this slot is reused as is, shared one is
+		 * replaced with a copy that points to the same children.
+		 */
+		static _Ptr_type&
+		own(_Ptr_type& node)
+		{
+			if (node.use_count() > 1)
+				node = create(*node);
+			else
+				std::atomic_thread_fence(std::memory_order_acquire);
+
+			return node;
+		}
+
+		/* ------------------- Balancing ----------------------*/
+
+		void refresh_node_height()
+		{
+			size_type lh = (left ? left->height + 1 : 0);
+			size_type rh = (right ? right->height + 1 : 0);
+
+			height = (lh > rh ? lh : rh);
+		}
+
+		size_type
+		node_delta_height() const
+		{
+			size_type lh = (left ? left->height + 1 : 0);
+			size_type rh = (right ? right->height + 1 : 0);
+			
+			return lh - rh;
+		}
+
+		/**
+		 * @brief rebalance node in slot, node must be already owned
+		 */
+		static void
+		rebalance(_Ptr_type& node)
+		{
+			node->refresh_node_height();
+
+			switch (node->node_delta_height())
+			{
+				case 2:
+					if (node->left->node_delta_height() < 0)
+						turnleft(node->left);
+
+					turnright(node);
+					return;
+
+				case -2:
+					if (node->right->node_delta_height() > 0)
+						turnright(node->right);
+
+					turnleft(node);
+					return;
+				
+				default:
+					return;
+			}
+		}
+
+		static void
+		turnleft(_Ptr_type& node)
+		{
+			_Ptr_type child = std::move(own(own(node)->right));
+			node->right = std::move(child->left);
+			node->refresh_node_height();
+			child->left = std::move(node);
+			child->refresh_node_height();
+			node = std::move(child);
+		}
+
+		static void
+		turnright(_Ptr_type& node)
+		{
+			_Ptr_type child = std::move(own(own(node)->left));
+			node->left = std::move(child->right);
+			node->refresh_node_height();
+			child->right = std::move(node);
+			child->refresh_node_height();
+			node = std::move(child);
+		}
+
+		/* ------------------- Bulk ----------------------*/
+
+		/**
+		 * @brief build balanced tree of __n sorted values in linear time
+		 *
+		 * Values are taken in order from __first, which is advanced past
+		 * them. Halves differ in size by one at most, so do their heights.
+		 */
+		template<typename _ForwardIt>
+		static _Ptr_type
+		build_sorted(_ForwardIt& __first, std::size_t __n)
+		{
+			if (__n == 0)
+				return nullptr;
+
+			_Ptr_type left = build_sorted(__first, __n / 2);
+			_Ptr_type node = create(*__first);
+			++__first;
+			node->left = std::move(left);
+			node->right = build_sorted(__first, __n - __n / 2 - 1);
+			node->refresh_node_height();
+
+			return node;
+		}
+
+		/**
+		 * @brief append values of the subtree in sorted order
+		 */
+		static void
+		collect_sorted(_Raw_ptr_type node, std::vector<_Key>& out)
+		{
+			if (!node)
+				return;
+
+			collect_sorted(node->left.get(), out);
+			out.push_back(node->value);
+			collect_sorted(node->right.get(), out);
+		}
+
+		/**
+		 * @brief Fall down recursively, insert and rebalance on the way up
+		 *
+		 * Path from the slot to the new leaf is copied where it is shared.
+		 * Value is only compared on the way down, and moved into the leaf
+		 * if it is an rvalue.
+		 */
+		template<typename _Arg>
+		static void
+		node_insert(_Ptr_type& node, _Arg&& _value, _Comp comp = _Comp{})
+		{
+			own(node);
+
+			if (comp(_value, node->value))
+			{
+				if (node->left)
+					node_insert(node->left, std::forward<_Arg>(_value));
+				else
+					node->left = create(std::forward<_Arg>(_value));
+			}
+			else
+			{
+				if (node->right)
+					node_insert(node->right, std::forward<_Arg>(_value));
+				else
+					node->right = create(std::forward<_Arg>(_value));
+			}
+
+			rebalance(node);
+		}
+
+	};
+}
+
+#endif
@@ -0,0 +1,148 @@
+/**
+ * @file  write_set.h
+ *
+ * @brief Implementation of the class WriteSet.
+ */
+
+#ifndef __WRITE_SET_H__
+#define __WRITE_SET_H__
+
+#include <cstddef>
+#include <iterator>
+
+class VersionedI;
+
+/**
+ * @brief Set of Versioned variables written in a Segment
+ *
+ * Open-addressed hash set of pointers. The first few variables fit into
+ * slots inside the set itself, so most Segments never allocate, and a
+ * larger table is allocated only when they run out. Removal leaves a
+ * tombstone, so insert and erase are O(1) and iteration is a linear scan
+ * over a flat array.
+ */
+class WriteSet
+{
+public:
+	/**
+	 * @brief Iterator over variables in the set
+	 *
+	 */
+	class iterator
+	{
+	public:
+		typedef VersionedI* value_type;
+		typedef VersionedI* const& reference;
+		typedef VersionedI* const* pointer;
+		typedef std::ptrdiff_t difference_type;
+		typedef std::forward_iterator_tag iterator_category;
+
+		iterator() = default;
+
+		reference operator*() const { return *cur; }
+		pointer operator->() const { return cur; }
+
+		iterator& operator++() {
+			++cur;
+			skip();
+			return *this;
+		}
+
+		iterator operator++(int) {
+			iterator tmp = *this;
+			++*this;
+			return tmp;
+		}
+
+		friend bool operator==(const iterator& x, const iterator& y) { return x.cur == y.cur; }
+		friend bool operator!=(const iterator& x, const iterator& y) { return x.cur != y.cur; }
+
+	private:
+		friend class WriteSet;
+
+		iterator(VersionedI* const* cur, VersionedI* const* end) : cur(cur), end(end) { skip(); }
+
+		/* move to the next occupied slot */
+		void skip() {
+			while (cur != end && !occupied(*cur))
+				++cur;
+		}
+
+		VersionedI* const* cur = nullptr;
+		VersionedI* const* end = nullptr;
+	};
+
+	WriteSet() = default;
+	WriteSet(const WriteSet&) = delete;
+	WriteSet& operator=(const WriteSet&) = delete;
+
+	/**
+	 * @brief Free the table if it was allocated
+	 *
+	 */
+	~WriteSet();
+
+	/**
+	 * @brief Add variable to the set
+	 *
+	 * Doesn't modify the set if variable is already there, so it is safe
+	 * to call concurrently for variables that are known to be present.
+	 *
+	 * @param v Variable
+	 * @return bool false if it was already there
+	 */
+	bool insert(VersionedI* v);
+
+	/**
+	 * @brief Remove variable from the set
+	 *
+	 * @param v Variable
+	 * @return bool false if it was not there
+	 */
+	bool erase(VersionedI* v);
+
+	/**
+	 * @brief Check that variable is in the set
+	 *
+	 */
+	bool contains(VersionedI* v) const;
+
+	/**
+	 * @brief Remove all variables and free allocated table
+	 *
+	 */
+	void clear();
+
+	std::size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+
+	iterator begin() const { return iterator(slots, slots + capacity); }
+	iterator end() const { return iterator(slots + capacity, slots + capacity); }
+
+private:
+	static constexpr std::size_t inline_capacity = 8;
+
+	/* marks removed slot, so probing goes on past it */
+	static VersionedI* const tombstone;
+
+	static bool occupied(VersionedI* v) { return v != nullptr && v != tombstone; }
+
+	/**
+	 * @brief Slot where v is, or where it should be inserted
+	 */
+	VersionedI** probe(VersionedI* v) const;
+
+	/**
+	 * @brief Move all variables to a table of new capacity
+	 */
+	void rehash(std::size_t new_capacity);
+
+	VersionedI* inline_slots[inline_capacity] = {};
+	VersionedI** slots = inline_slots;
+	std::size_t capacity = inline_capacity;
+	std::size_t count = 0;
+	/* occupied and tombstone slots */
+	std::size_t used = 0;
+};
+
+#endif
@@ -1,24 +1,216 @@
 #include "revision.h"
 #include "versioned.h"
 #include "segment.h"
+#include "pool_allocator.h"
+#include "stats.h"
+#include "trace.h"
+#include "vs_task.h"
+#include <algorithm>
+#include <atomic>
 #include <sstream>
+#include <vector>
 
-thread_local std::shared_ptr<Revision> Revision::currentRevision = std::make_shared<Revision>();
+thread_local std::shared_ptr<Revision> Revision::currentRevision = MakePooled<Revision>();
 
 Revision::Revision() {
-    std::shared_ptr<Segment> s = std::make_shared<Segment>();
+    std::shared_ptr<Segment> s = MakePooled<Segment>();
     root = s;
     current = s;
+    compactedDepth = s->depth;
 }
 
 Revision::Revision(std::shared_ptr<Segment> my_root, std::shared_ptr<Segment> my_current) {
     root = my_root;
     current = my_current;
+    compactedDepth = my_current->depth;
 }
 
-void PrintRevision(std::shared_ptr<Revision> revision) {
+static std::atomic<std::size_t> compactionLength = 64;
+
+void SetCompactionLength(std::size_t length) {
+    compactionLength.store(length, std::memory_order_relaxed);
+}
+
+std::size_t GetCompactionLength() {
+    return compactionLength.load(std::memory_order_relaxed);
+}
+
+std::size_t CompactRevision(const std::shared_ptr<Revision>& main, std::size_t budget) {
+    Trace::Scope scope("compact", "segment", main->current->version);
+    std::size_t folded = 0;
+    std::vector<std::shared_ptr<Segment>> chain{main->current};
+
+    /* chain stops below the root, or at it if nothing was forked yet */
+    while (chain.size() <= budget && chain.back() != main->root && chain.back()->parent
+            && chain.back()->parent != main->root)
+        chain.push_back(chain.back()->parent);
+
+    /* oldest first, so versions of a run of unshared Segments go all the way down */
+    for (std::size_t i = chain.size() - 1; i > 0; i--) {
+        Segment& p = *chain[i];
+        if (!p.written.empty() && p.refcount.load(std::memory_order_acquire) == 1) {
+            chain[i - 1]->FoldParent(main);
+            folded++;
+        }
+    }
+
+    main->compactedDepth = main->current->depth;
+    return folded;
+}
+
+std::shared_ptr<Revision> ForkRevision() {
+    std::shared_ptr<Revision>& main = Revision::currentRevision;
+
+    Stats::Fork();
+    auto s = MakePooled<Segment>(main->current);
+    auto forked = MakePooled<Revision>(main->current, s);
+    main->current->Release();
+    main->current = MakePooled<Segment>(main->current);
+
+    std::size_t length = GetCompactionLength();
+    if (length && static_cast<std::size_t>(main->current->depth - main->compactedDepth) >= length)
+        CompactRevision(main, 2 * length);
+
+    Trace::Instant("fork", "segment", s->version);
+    return forked;
+}
+
+std::shared_ptr<Revision> ForkRevision(const Revision& sibling) {
+    std::shared_ptr<Revision>& main = Revision::currentRevision;
+
+    /* nothing written since sibling was forked, so its start is our state */
+    if (main->current->parent != sibling.root || !main->current->written.empty())
+        return ForkRevision();
+
+    Stats::Fork();
+    auto s = MakePooled<Segment>(sibling.root);
+    Trace::Instant("fork", "segment", s->version);
+    return MakePooled<Revision>(sibling.root, s);
+}
+
+std::shared_ptr<Segment> PinRevision() {
+    std::shared_ptr<Segment>& current = Revision::currentRevision->current;
+
+    /* nothing written since the last fork, so parent is in the same state */
+    if (current->written.empty() && current->parent) {
+        current->parent->refcount.fetch_add(1, std::memory_order_relaxed);
+        return current->parent;
+    }
+
+    /* reference of the Revision goes to the caller, like in fork */
+    std::shared_ptr<Segment> pinned = current;
+    current = MakePooled<Segment>(pinned);
+    return pinned;
+}
+
+static std::atomic<std::size_t> parallelMergeCutoff = 4096;
+
+/* fewest variables worth handing to another worker */
+static constexpr std::size_t mergePartMin = 512;
+
+void SetParallelMergeCutoff(std::size_t cutoff) {
+    parallelMergeCutoff.store(cutoff, std::memory_order_relaxed);
+}
+
+std::size_t GetParallelMergeCutoff() {
+    return parallelMergeCutoff.load(std::memory_order_relaxed);
+}
+
+namespace {
+
+struct MergeItem {
+    VersionedI* var;
+    std::size_t segment;
+    /* Merge wrote a version in main */
+    bool merged = false;
+};
+
+}
+
+/**
+ * @brief Merge written variables on the worker pool
+ *
+ * Merge of a variable touches only its own versions, so variables are
+ * merged independently. The only shared state is the write set of
+ * main's current Segment, which gets all variables up front, and the
+ * ReadCache of main. Variables whose Merge wrote nothing are taken out
+ * of the write set afterwards, as nothing erases them when destroyed.
+ */
+static void ParallelJoin(const std::shared_ptr<Revision>& main, const std::shared_ptr<Revision>& joinRev,
+        std::size_t count) {
+    /* Segments of joinRev, newest first */
+    std::vector<std::shared_ptr<Segment>> segments;
+    /* each variable goes to one part, in the order of serial merge */
+    std::vector<std::vector<MergeItem>> parts(count);
+    /* variables that were not in the write set before */
+    std::vector<VersionedI*> added;
+
+    for (std::shared_ptr<Segment> s = joinRev->current; s != joinRev->root; s = s->parent) {
+        std::size_t index = segments.size();
+        segments.push_back(s);
+        for (auto v: s->written) {
+            parts[v->id % count].push_back({v, index});
+            if (main->current->written.insert(v))
+                added.push_back(v);
+            main->cache.invalidate(v->id);
+        }
+    }
+
+    vs::WorkerPool::instance().parallelFor(count, [&](std::size_t part) {
+        /* own Revision object over the same Segments, so ReadCache is not shared */
+        auto view = MakePooled<Revision>(main->root, main->current);
+        for (MergeItem& i: parts[part]) {
+            Trace::Scope scope("merge", "variable", i.var->id);
+            i.merged = i.var->Merge(view, joinRev, segments[i.segment]);
+        }
+    });
+
+    if (added.empty())
+        return;
+
+    WriteSet merged;
+    for (const auto& p: parts)
+        for (const MergeItem& i: p)
+            if (i.merged)
+                merged.insert(i.var);
+    for (auto v: added)
+        if (!merged.contains(v))
+            main->current->written.erase(v);
+}
+
+void JoinRevision(std::shared_ptr<Revision> joinRev) {
+    JoinRevision(Revision::currentRevision, std::move(joinRev));
+}
+
+void JoinRevision(const std::shared_ptr<Revision>& main, std::shared_ptr<Revision> joinRev) {
+    Stats::JoinTimer timer;
+    Trace::Scope scope("join", "segment", joinRev->current->version);
+    std::size_t written = 0;
+    for (std::shared_ptr<Segment> s = joinRev->current; s != joinRev->root; s = s->parent)
+        written += s->written.size();
+
+    /* joining thread merges a part too */
+    std::size_t parts = std::min(vs::WorkerPool::instance().size() + 1, written / mergePartMin);
+    if (written >= GetParallelMergeCutoff() && parts > 1) {
+        ParallelJoin(main, joinRev, parts);
+    } else {
+        std::shared_ptr<Segment> s = joinRev->current;
+        while (s != joinRev->root) {
+            for (auto v: s->written) {
+                Trace::Scope merge("merge", "variable", v->id);
+                v->Merge(main, joinRev, s);
+            }
+            s = s->parent;
+        }
+    }
+
+    joinRev->current->Release();
+    main->current->Collapse(main);
+}
+
+void PrintRevision(std::shared_ptr<Revision> revision, std::ostream& out) {
     if (revision == nullptr) {
-		std::cout << "Revision is null" << std::endl;
+        out << "Revision is null" << std::endl;
         return;
     }
 
@@ -28,9 +220,9 @@ void PrintRevision(std::shared_ptr<Revision> revision) {
     o << std::endl;
     while (s) {
         o << "thread: "<< std::this_thread::get_id() << ", segment ver:" << s->version
-             << ", addr: " << s << ", refcount: " << s->refcount << ", written size: "  << s->written.size() << std::endl;
+             << ", addr: " << s << ", refcount: " << s->refcount.load() << ", written size: "  << s->written.size() << std::endl;
         s = s->parent;
     }
 
-    std::cout << o.str() << std::endl;
+    out << o.str() << std::endl;
 }
@@ -1,27 +1,44 @@
 #include "segment.h"
 #include "versioned.h"
 #include "revision.h"
+#include "trace.h"
 
-int Segment::versionCount = 0;
+alignas(64) std::atomic<Segment::version_type> Segment::versionCount = 0;
 
-Segment::Segment() {
+Segment::version_type Segment::NextVersion() {
+    /* threads take whole blocks, so the shared counter is rarely touched */
+    thread_local version_type next = 0;
+    thread_local version_type end = 0;
+
+    if (next == end) {
+        next = versionCount.fetch_add(versionBlock, std::memory_order_relaxed);
+        end = next + versionBlock;
+    }
+    return next++;
+}
+
+Segment::Segment() : refcount(1) {
     parent = nullptr;
+    depth = 0;
+    Link();
 
-    version = versionCount++;
-    refcount = 1;
+    version = NextVersion();
 }
 
-Segment::Segment(std::shared_ptr<Segment> my_parent) {
+Segment::Segment(std::shared_ptr<Segment> my_parent) : refcount(1) {
     parent = my_parent;
     if (parent)
-        parent->refcount++;
+        parent->refcount.fetch_add(1, std::memory_order_relaxed);
+    depth = parent ? parent->depth + 1 : 0;
+    Link();
 
-    version = versionCount++;
-    refcount = 1;
+    version = NextVersion();
 }
 
 void Segment::Release() {
-    if (--refcount == 0) {
+    /* last owner has to see all writes to versions made by other owners */
+    if (refcount.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        Trace::Instant("release", "segment", version);
         for (auto &v: written) {
             v->Release(shared_from_this());
         }
@@ -31,10 +48,59 @@ void Segment::Release() {
 }
 
 void Segment::Collapse(std::shared_ptr<Revision> main) {
-    while (parent != main->root && parent->refcount == 1) {
+    Trace::Scope scope("collapse", "segment", version);
+    while (parent != main->root && parent->refcount.load(std::memory_order_acquire) == 1) {
         for(auto &v : parent->written) {
             v->Collapse(main, parent);
         }
         parent = parent->parent; // remove parent
     }
+    Link();
+}
+
+void Segment::FoldParent(std::shared_ptr<Revision> main) {
+    std::shared_ptr<Segment> self = shared_from_this();
+
+    for (auto &v : parent->written) {
+        v->Fold(main, parent, self);
+    }
+    parent->written.clear();
+}
+
+void Segment::Link() {
+    if (!parent) {
+        jump = nullptr;
+        return;
+    }
+
+    const Segment* p = parent.get();
+
+    /* two equal jumps in a row merge into one twice as long */
+    if (p->jump && p->jump->jump &&
+        p->depth - p->jump->depth == p->jump->depth - p->jump->jump->depth)
+        jump = p->jump->jump;
+    else
+        jump = p;
+}
+
+bool Segment::Unshared(const Segment* ancestor) const {
+    for (const Segment* s = this; ; s = s->parent.get()) {
+        /* pairs with release in Release of other owners */
+        if (s->refcount.load(std::memory_order_acquire) != 1)
+            return false;
+        if (s == ancestor)
+            return true;
+    }
+}
+
+const Segment* Segment::Ancestor(depth_type d) const {
+    const Segment* s = this;
+
+    while (s->depth > d) {
+        if (s->jump->depth >= d)
+            s = s->jump;
+        else
+            s = s->parent.get();
+    }
+    return s;
 }
@@ -0,0 +1,329 @@
+#include "stats.h"
+#include <algorithm>
+#include <cxxabi.h>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+thread_local Stats::Counters* Stats::local = nullptr;
+
+/* all blocks of counters, blocks are never freed */
+struct StatsRegistry {
+    std::mutex mutex;
+    std::vector<Stats::Counters*> blocks;
+    Stats::Counters* free = nullptr;
+    std::vector<std::string> strategies;
+};
+
+static StatsRegistry& registry() {
+    /* never destroyed, threads may record after static destructors */
+    static StatsRegistry* r = new StatsRegistry();
+    return *r;
+}
+
+namespace {
+
+std::string demangle(const char* name) {
+    int status = 0;
+    char* res = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+    if (status != 0)
+        return name;
+    std::string s(res);
+    std::free(res);
+    return s;
+}
+
+}
+
+void StatsHistogram::add(const StatsHistogram& other) {
+    for (std::size_t b = 0; b < buckets; b++)
+        counts[b] += other.counts[b];
+    count += other.count;
+    sum += other.sum;
+}
+
+/* shared block of threads that record after their own one is given back */
+Stats::Counters& Stats::Exited() {
+    static Counters* c = [] {
+        auto res = new Counters();
+        res->shared = true;
+        StatsRegistry& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.blocks.push_back(res);
+        return res;
+    }();
+    return *c;
+}
+
+void Stats::Detach() {
+    Counters* c = local;
+    if (!c || c->shared)
+        return;
+
+    /* everything recorded after this goes to the shared block */
+    local = &Exited();
+    StatsRegistry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    c->nextFree = r.free;
+    r.free = c;
+}
+
+/* gives the block of the thread back when it exits */
+struct StatsOwner {
+    ~StatsOwner() {
+        Stats::Detach();
+    }
+};
+
+static thread_local StatsOwner owner;
+
+Stats::Counters& Stats::Attach() {
+    (void)&owner;
+
+    StatsRegistry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    if (r.free) {
+        local = r.free;
+        r.free = local->nextFree;
+    } else {
+        local = new Counters();
+        r.blocks.push_back(local);
+    }
+    return *local;
+}
+
+std::size_t Stats::RegisterStrategy(const char* name) {
+    std::string s = demangle(name);
+
+    StatsRegistry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    if (r.strategies.size() == maxStrategies - 1)
+        r.strategies.push_back("other");
+    if (r.strategies.size() == maxStrategies)
+        return maxStrategies - 1;
+
+    r.strategies.push_back(s);
+    return r.strategies.size() - 1;
+}
+
+template <class Cells>
+static void collect(StatsHistogram& dst, const Cells& src) {
+    for (std::size_t b = 0; b < StatsHistogram::buckets; b++)
+        dst.counts[b] += src.counts[b].load(std::memory_order_relaxed);
+    dst.count += src.count.load(std::memory_order_relaxed);
+    dst.sum += src.sum.load(std::memory_order_relaxed);
+}
+
+template <class Cells>
+static void reset(Cells& cells) {
+    for (auto& c: cells.counts)
+        c.store(0, std::memory_order_relaxed);
+    cells.count.store(0, std::memory_order_relaxed);
+    cells.sum.store(0, std::memory_order_relaxed);
+}
+
+StatsSnapshot CollectStats() {
+    StatsSnapshot res;
+    std::uint64_t counters[Stats::CounterCount] = {};
+
+    StatsRegistry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    std::vector<StrategyStats> strategies(r.strategies.size());
+
+    for (Stats::Counters* c: r.blocks) {
+        for (std::size_t i = 0; i < Stats::CounterCount; i++)
+            counters[i] += c->counters[i].load(std::memory_order_relaxed);
+        collect(res.chainWalk, c->histograms[Stats::ChainWalkHist]);
+        collect(res.versionsPerVariable, c->histograms[Stats::VersionsPerVariable]);
+        collect(res.joinTime, c->histograms[Stats::JoinTime]);
+        for (std::size_t i = 0; i < strategies.size(); i++) {
+            collect(strategies[i].merge, c->strategies[i][0]);
+            collect(strategies[i].collapse, c->strategies[i][1]);
+        }
+    }
+
+    res.copies = counters[Stats::Copies];
+    res.bytesCopied = counters[Stats::BytesCopied];
+    res.moves = counters[Stats::Moves];
+    res.versionsCreated = counters[Stats::VersionsCreated];
+    res.versionsReleased = counters[Stats::VersionsReleased];
+    res.folds = counters[Stats::Folds];
+    res.gets = counters[Stats::Gets];
+    res.cacheHits = counters[Stats::CacheHits];
+    res.forks = counters[Stats::Forks];
+    res.joins = counters[Stats::Joins];
+
+    for (std::size_t i = 0; i < strategies.size(); i++)
+        res.strategies[r.strategies[i]] = strategies[i];
+    return res;
+}
+
+void ResetStats() {
+    StatsRegistry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+
+    for (Stats::Counters* c: r.blocks) {
+        for (auto& counter: c->counters)
+            counter.store(0, std::memory_order_relaxed);
+        for (auto& h: c->histograms)
+            reset(h);
+        for (auto& s: c->strategies) {
+            reset(s[0]);
+            reset(s[1]);
+        }
+    }
+}
+
+/* ------------------ Export ----------------------*/
+
+namespace {
+
+struct Metric {
+    const char* name;
+    std::uint64_t StatsSnapshot::* field;
+};
+
+const Metric counterMetrics[] = {
+    {"copies", &StatsSnapshot::copies},
+    {"bytes_copied", &StatsSnapshot::bytesCopied},
+    {"moves", &StatsSnapshot::moves},
+    {"versions_created", &StatsSnapshot::versionsCreated},
+    {"versions_released", &StatsSnapshot::versionsReleased},
+    {"folds", &StatsSnapshot::folds},
+    {"gets", &StatsSnapshot::gets},
+    {"cache_hits", &StatsSnapshot::cacheHits},
+    {"forks", &StatsSnapshot::forks},
+    {"joins", &StatsSnapshot::joins},
+};
+
+struct HistogramMetric {
+    const char* name;
+    StatsHistogram StatsSnapshot::* field;
+};
+
+const HistogramMetric histogramMetrics[] = {
+    {"chain_walk_segments", &StatsSnapshot::chainWalk},
+    {"versions_per_variable", &StatsSnapshot::versionsPerVariable},
+    {"join_nanoseconds", &StatsSnapshot::joinTime},
+};
+
+/* buckets after the last used one are left out */
+std::size_t usedBuckets(const StatsHistogram& h) {
+    std::size_t n = StatsHistogram::buckets;
+    while (n > 0 && h.counts[n - 1] == 0)
+        n--;
+    return n;
+}
+
+std::string escape(const std::string& s) {
+    std::string res;
+    for (char c: s) {
+        if (c == '"' || c == '\\')
+            res += '\\';
+        res += c;
+    }
+    return res;
+}
+
+void jsonHistogram(std::ostream& o, const StatsHistogram& h) {
+    o << "{\"count\": " << h.count << ", \"sum\": " << h.sum << ", \"buckets\": [";
+    std::size_t n = usedBuckets(h);
+    for (std::size_t b = 0; b < n; b++) {
+        if (b)
+            o << ", ";
+        o << "{\"le\": ";
+        if (b == StatsHistogram::buckets - 1)
+            o << "\"+Inf\"";
+        else
+            o << StatsHistogram::bound(b) - 1;
+        o << ", \"count\": " << h.counts[b] << "}";
+    }
+    o << "]}";
+}
+
+/* buckets are cumulative in Prometheus */
+void promHistogram(std::ostream& o, const std::string& name, const std::string& labels, const StatsHistogram& h) {
+    std::string sep = labels.empty() ? "" : ",";
+    std::uint64_t total = 0;
+    std::size_t n = std::min(usedBuckets(h), StatsHistogram::buckets - 1);
+
+    for (std::size_t b = 0; b < n; b++) {
+        total += h.counts[b];
+        o << name << "_bucket{" << labels << sep << "le=\"" << StatsHistogram::bound(b) - 1 << "\"} " << total << "\n";
+    }
+    o << name << "_bucket{" << labels << sep << "le=\"+Inf\"} " << h.count << "\n";
+    std::string braces = labels.empty() ? "" : "{" + labels + "}";
+    o << name << "_sum" << braces << " " << h.sum << "\n";
+    o << name << "_count" << braces << " " << h.count << "\n";
+}
+
+}
+
+std::string StatsToJson(const StatsSnapshot& stats) {
+    std::ostringstream o;
+
+    o << "{\n  \"enabled\": " << (statsEnabled ? "true" : "false") << ",\n";
+    o << "  \"counters\": {";
+    for (const Metric& m: counterMetrics)
+        o << "\"" << m.name << "\": " << stats.*m.field << ", ";
+    o << "\"live_versions\": " << stats.liveVersions() << "},\n";
+
+    o << "  \"histograms\": {";
+    bool first = true;
+    for (const HistogramMetric& m: histogramMetrics) {
+        o << (first ? "\n" : ",\n") << "    \"" << m.name << "\": ";
+        jsonHistogram(o, stats.*m.field);
+        first = false;
+    }
+    o << "\n  },\n";
+
+    o << "  \"strategies\": {";
+    first = true;
+    for (const auto& [name, s]: stats.strategies) {
+        o << (first ? "\n" : ",\n") << "    \"" << escape(name) << "\": {\"merge_nanoseconds\": ";
+        jsonHistogram(o, s.merge);
+        o << ", \"collapse_nanoseconds\": ";
+        jsonHistogram(o, s.collapse);
+        o << "}";
+        first = false;
+    }
+    o << (first ? "" : "\n  ") << "}\n}\n";
+    return o.str();
+}
+
+std::string StatsToPrometheus(const StatsSnapshot& stats) {
+    std::ostringstream o;
+
+    for (const Metric& m: counterMetrics) {
+        o << "# TYPE vs_" << m.name << "_total counter\n";
+        o << "vs_" << m.name << "_total " << stats.*m.field << "\n";
+    }
+    o << "# TYPE vs_live_versions gauge\n";
+    o << "vs_live_versions " << stats.liveVersions() << "\n";
+
+    for (const HistogramMetric& m: histogramMetrics) {
+        std::string name = std::string("vs_") + m.name;
+        o << "# TYPE " << name << " histogram\n";
+        promHistogram(o, name, "", stats.*m.field);
+    }
+
+    o << "# TYPE vs_merge_nanoseconds histogram\n";
+    for (const auto& [name, s]: stats.strategies)
+        promHistogram(o, "vs_merge_nanoseconds", "strategy=\"" + escape(name) + "\"", s.merge);
+    o << "# TYPE vs_collapse_nanoseconds histogram\n";
+    for (const auto& [name, s]: stats.strategies)
+        promHistogram(o, "vs_collapse_nanoseconds", "strategy=\"" + escape(name) + "\"", s.collapse);
+    return o.str();
+}
+
+bool DumpStats(const std::string& path, StatsFormat format) {
+    StatsSnapshot stats = CollectStats();
+    std::ofstream out(path, std::ios::trunc);
+    if (!out)
+        return false;
+
+    out << (format == StatsFormat::Json ? StatsToJson(stats) : StatsToPrometheus(stats));
+    return static_cast<bool>(out.flush());
+}
@@ -0,0 +1,216 @@
+#include <algorithm>
+#include "vs_task.h"
+
+namespace vs {
+
+/* index of the worker running on this thread, or -1 */
+static thread_local long workerIndex = -1;
+
+void TaskState::run() {
+    std::shared_ptr<Revision> saved = std::move(Revision::currentRevision);
+    Revision::currentRevision = revision;
+
+    try {
+        invoke();
+    } catch (...) {
+        error = std::current_exception();
+    }
+
+    Revision::currentRevision = std::move(saved);
+    done.store(true, std::memory_order_release);
+    done.notify_all();
+}
+
+WorkerPool& WorkerPool::instance() {
+    static WorkerPool pool(std::max(1u, std::thread::hardware_concurrency()));
+    return pool;
+}
+
+WorkerPool::WorkerPool(std::size_t count) {
+    for (std::size_t i = 0; i < count; i++)
+        queues.push_back(std::make_unique<Worker>());
+    for (std::size_t i = 0; i < count; i++)
+        workers.emplace_back(&WorkerPool::workerLoop, this, i);
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stop = true;
+    }
+    sleepCv.notify_all();
+
+    for (auto& w: workers)
+        w.join();
+}
+
+void WorkerPool::submit(std::shared_ptr<Job> task) {
+    std::size_t index = workerIndex >= 0 ? workerIndex
+        : nextQueue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+
+    {
+        std::lock_guard<std::mutex> lock(queues[index]->mutex);
+        queues[index]->tasks.push_back(std::move(task));
+    }
+    pending.fetch_add(1, std::memory_order_release);
+
+    /* lock pairs with the predicate check of a falling asleep worker */
+    { std::lock_guard<std::mutex> lock(sleepMutex); }
+    sleepCv.notify_one();
+}
+
+std::shared_ptr<Job> WorkerPool::take() {
+    if (pending.load(std::memory_order_acquire) == 0)
+        return nullptr;
+
+    std::size_t n = queues.size();
+    std::size_t own = workerIndex >= 0 ? workerIndex : 0;
+
+    /* own deque from the back, others from the front */
+    for (std::size_t i = 0; i < n; i++) {
+        Worker& w = *queues[(own + i) % n];
+        std::lock_guard<std::mutex> lock(w.mutex);
+        if (w.tasks.empty())
+            continue;
+
+        std::shared_ptr<Job> task;
+        if (i == 0 && workerIndex >= 0) {
+            task = std::move(w.tasks.back());
+            w.tasks.pop_back();
+        } else {
+            task = std::move(w.tasks.front());
+            w.tasks.pop_front();
+        }
+        pending.fetch_sub(1, std::memory_order_relaxed);
+        return task;
+    }
+    return nullptr;
+}
+
+bool WorkerPool::runOne() {
+    std::shared_ptr<Job> task = take();
+    if (!task)
+        return false;
+
+    task->run();
+    return true;
+}
+
+namespace {
+
+/* calls of one parallelFor */
+struct ForState {
+    void run(std::size_t i) {
+        try {
+            (*f)(i);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (!error)
+                error = std::current_exception();
+        }
+
+        if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            remaining.notify_all();
+    }
+
+    const std::function<void(std::size_t)>* f;
+    std::atomic<std::size_t> remaining;
+
+    std::mutex errorMutex;
+    std::exception_ptr error;
+};
+
+struct ForJob : Job {
+    ForJob(std::shared_ptr<ForState> state, std::size_t i)
+    : state(std::move(state)), i(i) { }
+
+    void run() override { state->run(i); }
+
+    std::shared_ptr<ForState> state;
+    std::size_t i;
+};
+
+}
+
+void WorkerPool::parallelFor(std::size_t n, const std::function<void(std::size_t)>& f) {
+    if (n == 0)
+        return;
+
+    /* jobs keep the state alive until they are done with it */
+    auto state = std::make_shared<ForState>();
+    state->f = &f;
+    state->remaining.store(n, std::memory_order_relaxed);
+
+    for (std::size_t i = 1; i < n; i++)
+        submit(MakePooled<ForJob>(state, i));
+    state->run(0);
+
+    while (std::size_t left = state->remaining.load(std::memory_order_acquire)) {
+        if (!runOne())
+            state->remaining.wait(left, std::memory_order_acquire);
+    }
+
+    if (state->error)
+        std::rethrow_exception(state->error);
+}
+
+void WorkerPool::workerLoop(std::size_t index) {
+    workerIndex = index;
+
+    while (true) {
+        if (runOne())
+            continue;
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleepCv.wait(lock, [this]() { return stop || pending.load(std::memory_order_acquire) > 0; });
+        if (stop)
+            return;
+    }
+}
+
+void task::join() {
+    WorkerPool& pool = WorkerPool::instance();
+
+    /* help with queued work, the task itself may be among it */
+    while (!state->done.load(std::memory_order_acquire)) {
+        if (!pool.runOne())
+            state->done.wait(false, std::memory_order_acquire);
+    }
+
+    std::shared_ptr<TaskState> finished = std::move(state);
+    JoinRevision(finished->revision);
+
+    if (finished->error)
+        std::rethrow_exception(finished->error);
+}
+
+void task_group::join() {
+    WorkerPool& pool = WorkerPool::instance();
+    std::vector<std::shared_ptr<TaskState>> finished = std::move(tasks);
+    tasks.clear();
+
+    for (auto& t: finished) {
+        while (!t->done.load(std::memory_order_acquire)) {
+            if (!pool.runOne())
+                t->done.wait(false, std::memory_order_acquire);
+        }
+    }
+
+    /* pairs of a round are disjoint, so they are merged in parallel */
+    std::size_t n = finished.size();
+    for (std::size_t stride = 1; stride < n; stride *= 2) {
+        std::size_t pairs = (n - stride + 2 * stride - 1) / (2 * stride);
+        pool.parallelFor(pairs, [&finished, stride](std::size_t k) {
+            std::size_t i = 2 * stride * k;
+            JoinRevision(finished[i]->revision, finished[i + stride]->revision);
+        });
+    }
+    if (n)
+        JoinRevision(finished[0]->revision);
+
+    for (auto& t: finished)
+        if (t->error)
+            std::rethrow_exception(t->error);
+}
+
+}
@@ -0,0 +1,155 @@
+#include "trace.h"
+#include <algorithm>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <tuple>
+#include <vector>
+
+const std::chrono::steady_clock::time_point Trace::epoch = std::chrono::steady_clock::now();
+thread_local Trace::Buffer* Trace::local = nullptr;
+thread_local std::uint32_t Trace::tid = 0;
+
+/* all buffers, buffers are never freed */
+struct TraceRegistry {
+    std::mutex mutex;
+    std::vector<Trace::Buffer*> buffers;
+    Trace::Buffer* free = nullptr;
+    std::uint32_t threads = 0;
+};
+
+static TraceRegistry& registry() {
+    /* never destroyed, threads may record after static destructors */
+    static TraceRegistry* r = new TraceRegistry();
+    return *r;
+}
+
+Trace::Buffer& Trace::Exited() {
+    static Buffer* b = [] {
+        auto res = new Buffer();
+        res->shared = true;
+        TraceRegistry& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.buffers.push_back(res);
+        return res;
+    }();
+    return *b;
+}
+
+void Trace::Detach() {
+    Buffer* b = local;
+    if (!b || b->shared)
+        return;
+
+    /* everything recorded after this goes to the shared buffer */
+    local = &Exited();
+    TraceRegistry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    b->nextFree = r.free;
+    r.free = b;
+}
+
+/* gives the buffer of the thread back when it exits */
+struct TraceOwner {
+    ~TraceOwner() {
+        Trace::Detach();
+    }
+};
+
+static thread_local TraceOwner owner;
+
+Trace::Buffer& Trace::Attach() {
+    (void)&owner;
+
+    TraceRegistry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    tid = ++r.threads;
+    if (r.free) {
+        local = r.free;
+        r.free = local->nextFree;
+    } else {
+        local = new Buffer();
+        r.buffers.push_back(local);
+    }
+    return *local;
+}
+
+namespace {
+
+struct Copy {
+    const char* name;
+    const char* argName;
+    std::uint64_t arg;
+    std::uint64_t ts;
+    std::uint64_t dur;
+    std::uint32_t tid;
+};
+
+}
+
+std::string TraceToJson() {
+    std::vector<Copy> events;
+
+    TraceRegistry& r = registry();
+    {
+        std::lock_guard<std::mutex> lock(r.mutex);
+        for (Trace::Buffer* b: r.buffers) {
+            std::uint64_t head = b->head.load(std::memory_order_acquire);
+            std::uint64_t first = head > Trace::capacity ? head - Trace::capacity : 0;
+
+            for (std::uint64_t i = first; i < head; i++) {
+                Trace::Event& e = b->events[i % Trace::capacity];
+                if (e.seq.load(std::memory_order_acquire) != i + 1)
+                    continue;
+
+                Copy c{e.name.load(std::memory_order_relaxed), e.argName.load(std::memory_order_relaxed),
+                    e.arg.load(std::memory_order_relaxed), e.ts.load(std::memory_order_relaxed),
+                    e.dur.load(std::memory_order_relaxed), e.tid.load(std::memory_order_relaxed)};
+                /* event was overwritten while we read it */
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (e.seq.load(std::memory_order_relaxed) == i + 1)
+                    events.push_back(c);
+            }
+        }
+    }
+
+    std::sort(events.begin(), events.end(), [](const Copy& a, const Copy& b) {
+        return std::tie(a.ts, a.tid) < std::tie(b.ts, b.tid);
+    });
+
+    std::ostringstream o;
+    o << std::fixed;
+    o.precision(3);
+    o << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [";
+    for (std::size_t i = 0; i < events.size(); i++) {
+        const Copy& c = events[i];
+        o << (i ? ",\n" : "\n") << "{\"name\": \"" << c.name << "\", \"cat\": \"vs\", ";
+        if (c.dur == Trace::noDuration)
+            o << "\"ph\": \"i\", \"s\": \"t\", ";
+        else
+            o << "\"ph\": \"X\", \"dur\": " << c.dur / 1e3 << ", ";
+        o << "\"ts\": " << c.ts / 1e3 << ", \"pid\": 1, \"tid\": " << c.tid
+            << ", \"args\": {\"" << c.argName << "\": " << c.arg << "}}";
+    }
+    o << "\n]}\n";
+    return o.str();
+}
+
+void ResetTrace() {
+    TraceRegistry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+
+    for (Trace::Buffer* b: r.buffers)
+        for (auto& e: b->events)
+            e.seq.store(0, std::memory_order_relaxed);
+}
+
+bool DumpTrace(const std::string& path) {
+    std::string json = TraceToJson();
+    std::ofstream out(path, std::ios::trunc);
+    if (!out)
+        return false;
+
+    out << json;
+    return static_cast<bool>(out.flush());
+}
@@ -0,0 +1,107 @@
+#include "write_set.h"
+#include <cstdint>
+
+static char tombstone_mark;
+
+VersionedI* const WriteSet::tombstone = reinterpret_cast<VersionedI*>(&tombstone_mark);
+
+WriteSet::~WriteSet() {
+    if (slots != inline_slots)
+        delete[] slots;
+}
+
+VersionedI** WriteSet::probe(VersionedI* v) const {
+    std::uint64_t h = (reinterpret_cast<std::uintptr_t>(v) >> 4) * 0x9E3779B97F4A7C15ull;
+    std::size_t mask = capacity - 1;
+    std::size_t i = (h ^ (h >> 32)) & mask;
+    VersionedI** reuse = nullptr;
+
+    while (true) {
+        VersionedI** slot = &slots[i];
+        if (*slot == v)
+            return slot;
+        if (*slot == nullptr)
+            return reuse ? reuse : slot;
+        if (*slot == tombstone && !reuse)
+            reuse = slot;
+        i = (i + 1) & mask;
+    }
+}
+
+bool WriteSet::insert(VersionedI* v) {
+    /* present variable is not written at all, parallel merge relies on it */
+    VersionedI** slot = probe(v);
+    if (*slot == v)
+        return false;
+
+    /* keep at least a quarter of slots free, so probing stays short */
+    if ((used + 1) * 4 > capacity * 3) {
+        std::size_t new_capacity = capacity;
+        while ((count + 1) * 2 > new_capacity)
+            new_capacity *= 2;
+        rehash(new_capacity);
+        slot = probe(v);
+    }
+
+    if (*slot == nullptr)
+        used++;
+    *slot = v;
+    count++;
+    return true;
+}
+
+bool WriteSet::erase(VersionedI* v) {
+    VersionedI** slot = probe(v);
+    if (*slot != v)
+        return false;
+
+    *slot = tombstone;
+    count--;
+    return true;
+}
+
+bool WriteSet::contains(VersionedI* v) const {
+    return *probe(v) == v;
+}
+
+void WriteSet::clear() {
+    if (slots != inline_slots)
+        delete[] slots;
+
+    slots = inline_slots;
+    capacity = inline_capacity;
+    for (std::size_t i = 0; i < inline_capacity; i++)
+        slots[i] = nullptr;
+    count = 0;
+    used = 0;
+}
+
+void WriteSet::rehash(std::size_t new_capacity) {
+    VersionedI** old = slots;
+    std::size_t old_capacity = capacity;
+
+    slots = new_capacity == inline_capacity ? inline_slots : new VersionedI*[new_capacity]();
+    capacity = new_capacity;
+    used = count;
+
+    if (old == slots) {
+        /* same inline table, just drop tombstones */
+        VersionedI* live[inline_capacity];
+        std::size_t n = 0;
+        for (std::size_t i = 0; i < old_capacity; i++)
+            if (occupied(old[i]))
+                live[n++] = old[i];
+        for (std::size_t i = 0; i < inline_capacity; i++)
+            slots[i] = nullptr;
+        for (std::size_t i = 0; i < n; i++)
+            *probe(live[i]) = live[i];
+        return;
+    }
+
+    for (std::size_t i = 0; i < old_capacity; i++)
+        if (occupied(old[i]))
+            *probe(old[i]) = old[i];
+
+    if (old != inline_slots)
+        delete[] old;
+}
@@ -1,19 +1,34 @@
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <iterator>
 #include <functional>
 #include <list>
+#include <memory>
 #include <set>
 #include <sstream>
+#include <string>
+#include <vector>
 
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/matchers/catch_matchers_all.hpp>
 #include <catch2/matchers/catch_matchers_templated.hpp>
 
 #include "versioned.h"
+#include "logged_versioned.h"
+#include "pool_allocator.h"
 #include "revision.h"
+#include "stats.h"
+#include "trace.h"
 #include "vs_set.h"
 #include "vs_queue.h"
 #include "vs_stack.h"
 #include "vs_tree.h"
+#include "vs_task.h"
+#include "vs_revision_task.h"
+#include "vs_snapshot.h"
 #include "vs_thread.h"
 #include "test_utils.h"
 
@@ -91,6 +106,524 @@ TEST_CASE("Test versioning basic objects", "[int][basic]") {
 	}
 }
 
+TEST_CASE("Test of the version store", "[int][store]") {
+	std::vector<std::shared_ptr<Segment>> chain = {std::make_shared<Segment>()};
+	for (int i = 1; i < 50; i++)
+		chain.push_back(std::make_shared<Segment>(chain.back()));
+	auto branch = std::make_shared<Segment>(chain[20]);
+
+	VersionStore<std::string> store;
+
+	std::string& first = store.emplace(*chain[0], "v0");
+	for (int i = 1; i < 10; i++)
+		store.emplace(*chain[i], "v" + std::to_string(i));
+
+	REQUIRE(store.size() == 10);
+	REQUIRE(store.find(chain[0]->version) == &first);
+	REQUIRE(*store.find(chain[9]->version) == "v9");
+	REQUIRE(store.find(chain[10]->version) == nullptr);
+
+	store.erase(chain[3]->version);
+	REQUIRE(store.find(chain[3]->version) == nullptr);
+	REQUIRE(store.size() == 9);
+
+	store.emplace(*chain[42], "v42");
+	REQUIRE(store.at(chain[42]->version) == "v42");
+	REQUIRE(store.find(chain[0]->version) == &first);
+	REQUIRE_THROWS_AS(store.at(chain[3]->version), std::out_of_range);
+
+	REQUIRE(chain[49]->depth == 49);
+	for (int d = 0; d < 50; d++)
+		REQUIRE(chain[49]->Ancestor(d) == chain[d].get());
+
+	REQUIRE(*store.nearest(*chain[49]) == "v42");
+	REQUIRE(*store.nearest(*chain[41]) == "v9");
+	REQUIRE(*store.nearest(*chain[3]) == "v2");
+	REQUIRE(*store.nearest(*branch) == "v9");
+	REQUIRE(store.nearest(*chain[0]) == &first);
+}
+
+TEST_CASE("Test of the in-place update", "[int][update]") {
+	Versioned<std::vector<int>> x(std::vector<int>({1, 2}));
+
+	REQUIRE(x.Update([](std::vector<int>& v) { v.push_back(3); return true; }));
+	REQUIRE(x.Get() == std::vector<int>({1, 2, 3}));
+
+	std::vector<int> seen;
+	auto thread = vs::thread([&x, &seen]() {
+		/* first write in child Segment copies parent's version */
+		x.Update([](std::vector<int>& v) { v.push_back(4); return true; });
+		seen = x.Get();
+	});
+	REQUIRE_FALSE(x.Update([](std::vector<int>& v) { v[0] = 0; return false; }));
+	REQUIRE(x.Get() == std::vector<int>({0, 2, 3}));
+	thread.join();
+
+	REQUIRE(seen == std::vector<int>({1, 2, 3, 4}));
+	REQUIRE(x.Get() == std::vector<int>({1, 2, 3, 4}));
+}
+
+TEST_CASE("Test of the write set", "[int][writeset]") {
+	std::vector<std::unique_ptr<Versioned<int>>> vars;
+	for (int i = 0; i < 100; i++)
+		vars.push_back(std::make_unique<Versioned<int>>(i));
+
+	WriteSet set;
+	for (auto& v: vars)
+		REQUIRE(set.insert(v.get()));
+	REQUIRE_FALSE(set.insert(vars[5].get()));
+	REQUIRE(set.size() == 100);
+
+	for (int i = 0; i < 100; i += 2)
+		REQUIRE(set.erase(vars[i].get()));
+	REQUIRE_FALSE(set.erase(vars[0].get()));
+	REQUIRE(set.size() == 50);
+
+	std::set<VersionedI*> seen(set.begin(), set.end());
+	REQUIRE(seen.size() == 50);
+	for (int i = 0; i < 100; i++)
+		REQUIRE(set.contains(vars[i].get()) == (i % 2 == 1));
+
+	/* tombstones are reused and cleaned up */
+	for (int round = 0; round < 10; round++) {
+		for (int i = 0; i < 100; i += 2)
+			set.insert(vars[i].get());
+		for (int i = 0; i < 100; i += 2)
+			set.erase(vars[i].get());
+	}
+	REQUIRE(set.size() == 50);
+	REQUIRE(std::distance(set.begin(), set.end()) == 50);
+}
+
+TEST_CASE("Test of the pool allocator", "[int][pool]") {
+	auto a = MakePooled<Segment>();
+	Segment* addr = a.get();
+	a.reset();
+
+	/* freed block is the first one reused by the same thread */
+	auto b = MakePooled<Segment>();
+	REQUIRE(b.get() == addr);
+
+	/* blocks freed by other thread come back through its local list */
+	std::vector<std::shared_ptr<Segment>> segments;
+	for (int i = 0; i < 1000; i++)
+		segments.push_back(MakePooled<Segment>(b));
+	REQUIRE(b->refcount.load() == 1001);
+
+	std::thread([&segments]() { segments.clear(); }).join();
+	REQUIRE(b.use_count() == 1);
+
+	for (int i = 0; i < 1000; i++)
+		segments.push_back(MakePooled<Segment>(b));
+	REQUIRE(segments.back()->depth == b->depth + 1);
+}
+
+TEST_CASE("Test of the read cache", "[int][cache]") {
+	/* more variables than cache entries, so some of them share entries */
+	std::vector<std::unique_ptr<Versioned<int>>> vars;
+	for (int i = 0; i < 100; i++)
+		vars.push_back(std::make_unique<Versioned<int>>(i));
+
+	for (int round = 0; round < 2; round++)
+		for (int i = 0; i < 100; i++)
+			REQUIRE(vars[i]->Get() == i);
+
+	const int* before = &vars[7]->Get();
+	vars[7]->Set(700);
+	REQUIRE(vars[7]->Get() == 700);
+	REQUIRE(&vars[7]->Get() == before);
+
+	auto thread = vs::thread([&vars]() {
+		for (int i = 0; i < 100; i += 2) {
+			REQUIRE(vars[i]->Get() == (i == 7 ? 700 : i));
+			vars[i]->Set(-i);
+			REQUIRE(vars[i]->Get() == -i);
+		}
+	});
+	for (int i = 0; i < 100; i++)
+		REQUIRE(vars[i]->Get() == (i == 7 ? 700 : i));
+	vars[1]->Set(1000);
+	REQUIRE(vars[1]->Get() == 1000);
+
+	thread.join();
+	for (int i = 0; i < 100; i++)
+		REQUIRE(vars[i]->Get() == (i % 2 == 0 ? -i : i == 7 ? 700 : i == 1 ? 1000 : i));
+}
+
+TEST_CASE("Test of concurrent forks and joins", "[int][threads]") {
+	Versioned<int> x(0);
+	std::vector<vs::thread> drivers;
+	std::vector<int> seen(8);
+
+	/* vs::thread objects are moved around while their threads start */
+	for (int t = 0; t < 8; t++) {
+		drivers.emplace_back([&x, &seen, t]() {
+			for (int i = 0; i < 20; i++) {
+				vs::thread child([&x]() { x.Set(x.Get() + 1); });
+				child.join();
+			}
+			seen[t] = x.Get();
+		});
+	}
+	for (auto& d: drivers)
+		d.join();
+
+	REQUIRE_THAT(seen, Catch::Matchers::RangeEquals(std::vector<int>(8, 20)));
+	REQUIRE(x.Get() == 20);
+	REQUIRE(Revision::currentRevision->current->refcount.load() == 1);
+}
+
+TEST_CASE("Test of the vs::task", "[int][task]") {
+	Versioned<int> x(0);
+	Versioned<int> y(100);
+
+	SECTION("Task joins like a thread") {
+		auto t = vs::spawn([&x, &y]() {
+			x.Set(x.Get() + 1);
+			y.Set(101);
+		});
+		x.Set(11);
+		REQUIRE(x.Get() == 11);
+		REQUIRE(y.Get() == 100);
+
+		t.join();
+		REQUIRE(x.Get() == 1);
+		REQUIRE(y.Get() == 101);
+	}
+
+	SECTION("Tasks spawn and join tasks") {
+		std::function<int(int)> sum = [&sum](int n) {
+			if (n < 2)
+				return n;
+
+			Versioned<int> left(0);
+			vs::task t([&]() { left.Set(sum(n / 2)); });
+			int right = sum(n - n / 2);
+			t.join();
+			return left.Get() + right;
+		};
+		REQUIRE(sum(1000) == 1000);
+	}
+
+	SECTION("Many short tasks") {
+		std::vector<vs::task> tasks;
+		std::vector<std::unique_ptr<Versioned<int>>> vars;
+		for (int i = 0; i < 1000; i++)
+			vars.push_back(std::make_unique<Versioned<int>>(0));
+		for (int i = 0; i < 1000; i++)
+			tasks.push_back(vs::spawn([&vars, i]() { vars[i]->Set(i); }));
+		for (auto& t: tasks)
+			t.join();
+
+		for (int i = 0; i < 1000; i++)
+			REQUIRE(vars[i]->Get() == i);
+	}
+
+	SECTION("Exception is rethrown after join") {
+		auto t = vs::spawn([&x]() {
+			x.Set(7);
+			throw std::runtime_error("task failed");
+		});
+		REQUIRE_THROWS_AS(t.join(), std::runtime_error);
+		REQUIRE_FALSE(t.joinable());
+		REQUIRE(x.Get() == 7);
+	}
+}
+
+TEST_CASE("Test of the vs::task_group", "[int][group]") {
+	const int n = 13;
+	Versioned<int> x(-1);
+	std::vector<std::unique_ptr<Versioned<int>>> vars;
+	for (int i = 0; i < n; i++)
+		vars.push_back(std::make_unique<Versioned<int>>(0));
+
+	SECTION("Group forks off one Segment and joins like threads in order") {
+		auto depth = Revision::currentRevision->current->depth;
+
+		std::vector<int> seen(n);
+		vs::task_group g;
+		for (int i = 0; i < n; i++) {
+			g.run([&x, &vars, &seen, i]() {
+				seen[i] = x.Get();
+				vars[i]->Set(i);
+				x.Set(i);
+			});
+		}
+		REQUIRE(Revision::currentRevision->current->depth == depth + 1);
+		REQUIRE(g.size() == n);
+
+		g.join();
+		REQUIRE(g.size() == 0);
+		REQUIRE(x.Get() == n - 1);
+		for (int i = 0; i < n; i++) {
+			REQUIRE(seen[i] == -1);
+			REQUIRE(vars[i]->Get() == i);
+		}
+	}
+
+	SECTION("Write of the parent starts a new fork point") {
+		int first = 0, second = 0;
+		vs::task_group g;
+		g.run([&x, &first]() { first = x.Get(); });
+		x.Set(5);
+		g.run([&x, &second]() { second = x.Get(); x.Set(6); });
+		g.join();
+		REQUIRE(first == -1);
+		REQUIRE(second == 5);
+		REQUIRE(x.Get() == 6);
+	}
+
+	SECTION("Groups nest and merge sets") {
+		vs::vs_set<int> set;
+		vs::task_group outer;
+		for (int i = 0; i < 4; i++) {
+			outer.run([&set, i]() {
+				vs::task_group inner;
+				for (int j = 0; j < 4; j++)
+					inner.run([&set, i, j]() { set.insert(i * 4 + j); });
+				inner.join();
+			});
+		}
+		outer.join();
+
+		REQUIRE(set.size() == 16);
+		for (int i = 0; i < 16; i++)
+			REQUIRE(set.contains(i));
+	}
+
+	SECTION("Exception is rethrown after join") {
+		vs::task_group g;
+		g.run([&x]() { x.Set(1); });
+		g.run([]() { throw std::runtime_error("group failed"); });
+		g.run([&vars]() { vars[0]->Set(7); });
+		REQUIRE_THROWS_AS(g.join(), std::runtime_error);
+		REQUIRE(x.Get() == 1);
+		REQUIRE(vars[0]->Get() == 7);
+	}
+}
+
+/* resumes the coroutine on a new thread, which is stored to be joined */
+struct ResumeOnThread {
+	std::thread& thread;
+
+	bool await_ready() { return false; }
+
+	void await_suspend(std::coroutine_handle<> h) {
+		static std::mutex started;
+		std::lock_guard<std::mutex> lock(started);
+		/* coroutine must not finish before the thread is stored */
+		thread = std::thread([h]() {
+			{ std::lock_guard<std::mutex> wait(started); }
+			h.resume();
+		});
+	}
+
+	void await_resume() { }
+};
+
+static vs::revision_task<int> add_task(Versioned<int>& x, int n) {
+	x.Set(x.Get() + n);
+	co_return x.Get();
+}
+
+static vs::revision_task<int> sum_task(int n) {
+	if (n < 2)
+		co_return n;
+
+	Versioned<int> left(0);
+	auto l = sum_task(n / 2);
+	int right = co_await sum_task(n - n / 2);
+	left.Set(co_await std::move(l));
+	co_return left.Get() + right;
+}
+
+static vs::revision_task<> move_task(Versioned<int>& x, std::thread& thread, int& seen) {
+	x.Set(1);
+	co_await ResumeOnThread{thread};
+	/* still in own Revision, now on another thread */
+	seen = x.Get();
+	Versioned<int> base(5);
+	/* other operands may be evaluated after resumption */
+	int added = base.Get() + co_await add_task(x, 10);
+	x.Set(x.Get() + added);
+}
+
+static vs::revision_task<> throw_task(Versioned<int>& x) {
+	x.Set(7);
+	throw std::runtime_error("coroutine failed");
+	co_return;
+}
+
+TEST_CASE("Test of the revision_task coroutines", "[int][coroutine]") {
+	Versioned<int> x(0);
+
+	SECTION("Coroutine returns value and joins") {
+		auto t = add_task(x, 5);
+		x.Set(100);
+		REQUIRE(t.get() == 5);
+		REQUIRE(x.Get() == 5);
+	}
+
+	SECTION("Coroutines await coroutines") {
+		REQUIRE(sum_task(1000).get() == 1000);
+	}
+
+	SECTION("Revision survives resumption on another thread") {
+		std::thread thread;
+		int seen = 0;
+		auto t = move_task(x, thread, seen);
+		REQUIRE(x.Get() == 0);
+
+		t.get();
+		thread.join();
+		REQUIRE(seen == 1);
+		REQUIRE(x.Get() == 27);
+	}
+
+	SECTION("Exception is rethrown after join") {
+		REQUIRE_THROWS_AS(throw_task(x).get(), std::runtime_error);
+		REQUIRE(x.Get() == 7);
+	}
+}
+
+/* child writes every variable, its own child the odd ones once more */
+static std::vector<int> merge_many(std::size_t cutoff) {
+	std::size_t saved = GetParallelMergeCutoff();
+	SetParallelMergeCutoff(cutoff);
+
+	const int n = 5000;
+	std::vector<std::unique_ptr<Versioned<int>>> vars;
+	for (int i = 0; i < n + 100; i++)
+		vars.push_back(std::make_unique<Versioned<int>>(i));
+	LoggedVersioned<int> counter(0);
+
+	vs::thread child([&vars, &counter]() {
+		for (int i = 0; i < n; i++)
+			vars[i]->Set(vars[i]->Get() * 2);
+		counter.Apply([](int& c) { c++; });
+
+		vs::thread grandchild([&vars]() {
+			for (int i = 1; i < n; i += 2)
+				vars[i]->Set(vars[i]->Get() + 1);
+		});
+		grandchild.join();
+	});
+	for (int i = 0; i < n + 100; i += 2)
+		vars[i]->Set(-i);
+	counter.Apply([](int& c) { c++; });
+	child.join();
+
+	SetParallelMergeCutoff(saved);
+
+	std::vector<int> res;
+	for (auto& v: vars)
+		res.push_back(v->Get());
+	res.push_back(counter.Get());
+	return res;
+}
+
+TEST_CASE("Test of the parallel merge", "[int][merge]") {
+	std::vector<int> parallel = merge_many(0);
+	std::vector<int> serial = merge_many(SIZE_MAX);
+
+	REQUIRE(parallel == serial);
+	for (int i = 0; i < 5000; i++)
+		REQUIRE(parallel[i] == 2 * i + i % 2);
+	for (int i = 5000; i < 5100; i++)
+		REQUIRE(parallel[i] == (i % 2 ? i : -i));
+	REQUIRE(parallel.back() == 2);
+
+	/* child only reads, so its Merge writes nothing and nothing may stay in the write set */
+	std::size_t saved = GetParallelMergeCutoff();
+	SetParallelMergeCutoff(1);
+	{
+		std::vector<std::unique_ptr<LoggedVersioned<int>>> logged;
+		for (int i = 0; i < 2048; i++)
+			logged.push_back(std::make_unique<LoggedVersioned<int>>(i));
+		vs::thread first([]() {});
+		for (auto& x: logged)
+			x->Apply([](int& v) { v++; });
+		/* keeps Segment with the logs shared, so join does not collapse it */
+		vs::thread blocker([]() {});
+
+		long sum = 0;
+		vs::thread child([&logged, &sum]() {
+			for (auto& x: logged)
+				sum += x->Get();
+		});
+		child.join();
+		REQUIRE(sum == 2048 * 2049 / 2);
+		REQUIRE(Revision::currentRevision->current->written.empty());
+
+		logged.clear();
+		/* collapses the chain after variables are gone */
+		vs::thread after([]() {});
+		after.join();
+		blocker.join();
+		first.join();
+	}
+	SetParallelMergeCutoff(saved);
+}
+
+/* main writes while the previous fork still runs, so no join can collapse the chain */
+static std::size_t rolling_versions(std::size_t length, std::vector<int>& seen, std::vector<int>& counted,
+		int& logged) {
+	std::size_t saved = GetCompactionLength();
+	SetCompactionLength(length);
+
+	Versioned<int> x(-1);
+	LoggedVersioned<int> counter(0);
+	std::list<vs::thread> running;
+	for (int i = 0; i < (int)seen.size(); i++) {
+		x.Set(i);
+		counter.Apply([](int& c) { c++; });
+		/* forks read logs of Segments that are folded meanwhile */
+		running.emplace_back([&x, &counter, &seen, &counted, i]() {
+			seen[i] = x.Get();
+			counted[i] = counter.Get();
+		});
+		if (running.size() > 2) {
+			running.front().join();
+			running.pop_front();
+		}
+	}
+	std::size_t versions = x.versions.size();
+	for (auto& t: running)
+		t.join();
+
+	SetCompactionLength(saved);
+	logged = counter.Get();
+	return versions;
+}
+
+TEST_CASE("Test of the chain compaction", "[int][compact]") {
+	std::vector<int> seen(200);
+	std::vector<int> counted(200);
+	int logged = 0;
+
+	REQUIRE(rolling_versions(0, seen, counted, logged) > 100);
+	REQUIRE(logged == 200);
+
+	std::size_t versions = rolling_versions(8, seen, counted, logged);
+	REQUIRE(versions <= 2 * 8 + 4);
+	REQUIRE(logged == 200);
+	for (int i = 0; i < 200; i++) {
+		REQUIRE(seen[i] == i);
+		REQUIRE(counted[i] == i + 1);
+	}
+
+	SECTION("Nothing forked yet") {
+		/* current is the root, so there is nothing to fold */
+		auto fresh = std::make_shared<Revision>();
+		REQUIRE(CompactRevision(fresh, 8) == 0);
+
+		std::size_t folded = 1;
+		std::thread thread([&folded]() { folded = CompactRevision(Revision::currentRevision, 8); });
+		thread.join();
+		REQUIRE(folded == 0);
+	}
+}
+
 TEST_CASE("Test versioning of the lists", "[list][basic]") {
 	Versioned<std::list<int>> x = Versioned<std::list<int>>({0, 1, 2, 3});
 	Versioned<std::list<int>> y = Versioned<std::list<int>>({100, 101, 102, 103});
@@ -145,6 +678,55 @@ TEST_CASE("Test versioning of the sets", "[set][basic]") {
 	}
 }
 
+TEST_CASE("Test operation-log versioning", "[list][log]") {
+	LoggedVersioned<std::list<int>> x = LoggedVersioned<std::list<int>>({0, 1, 2, 3});
+
+	REQUIRE_THAT(x.Get(), Catch::Matchers::RangeEquals(std::list<int>({0, 1, 2, 3})));
+
+	SECTION("Child log is replayed on parent") {
+		auto thread = vs::thread([&x]() {
+			x.Apply([](std::list<int>& l) { l.push_back(4); });
+			REQUIRE_THAT(x.Get(), Catch::Matchers::RangeEquals(std::list<int>({0, 1, 2, 3, 4})));
+			x.Apply([](std::list<int>& l) { l.pop_front(); });
+			REQUIRE_THAT(x.Get(), Catch::Matchers::RangeEquals(std::list<int>({1, 2, 3, 4})));
+		});
+		x.Apply([](std::list<int>& l) { l.push_back(5); });
+		REQUIRE_THAT(x.Get(), Catch::Matchers::RangeEquals(std::list<int>({0, 1, 2, 3, 5})));
+
+		thread.join();
+		REQUIRE_THAT(x.Get(), Catch::Matchers::RangeEquals(std::list<int>({1, 2, 3, 5, 4})));
+	}
+
+	SECTION("Writes without reads do not materialize") {
+		auto thread = vs::thread([&x]() {
+			x.Apply([](std::list<int>& l) { l.push_back(4); });
+		});
+		thread.join();
+		x.Set({7});
+		x.Apply([](std::list<int>& l) { l.push_back(8); });
+
+		int materialized = 0;
+		for (auto& v: x.versions)
+			materialized += v.second.value.has_value();
+		REQUIRE(materialized == 1);
+		REQUIRE_THAT(x.Get(), Catch::Matchers::RangeEquals(std::list<int>({7, 8})));
+	}
+
+	SECTION("Unrelated Revision has no value") {
+		/* plain thread starts its own Revision, which never saw x */
+		bool thrown = false;
+		std::thread thread([&x, &thrown]() {
+			try {
+				x.Get();
+			} catch (const std::out_of_range&) {
+				thrown = true;
+			}
+		});
+		thread.join();
+		REQUIRE(thrown);
+	}
+}
+
 TEST_CASE("Test of the vs_sets", "[set][custom]") {
 	vs::vs_set<int> x{0, 1, 2, 3};
 	vs::vs_set<int> y{100, 101, 102, 103};
@@ -171,6 +753,60 @@ TEST_CASE("Test of the vs_sets", "[set][custom]") {
 	}
 }
 
+TEST_CASE("Test of the vs_sets with persistent_set", "[set][persistent]") {
+	typedef vs::vs_set<int, std::less<int>, vs::vs_set_strategy<int, std::less<int>>,
+		vs::persistent_set<int>> pset;
+	pset x{3, 1, 0, 2};
+
+	REQUIRE_THAT(x, Catch::Matchers::RangeEquals(std::vector<int>({0, 1, 2, 3})));
+
+	SECTION("Changing set in both threads") {
+		auto thread = vs::thread([&x]() {
+			REQUIRE_THAT(x, Catch::Matchers::RangeEquals(std::vector<int>({0, 1, 2, 3})));
+			REQUIRE(x.insert(4));
+			REQUIRE_FALSE(x.insert(4));
+			REQUIRE_THAT(x, Catch::Matchers::RangeEquals(std::vector<int>({0, 1, 2, 3, 4})));
+		});
+		x.insert(-1);
+		REQUIRE_THAT(x, Catch::Matchers::RangeEquals(std::vector<int>({-1, 0, 1, 2, 3})));
+		thread.join();
+		REQUIRE_THAT(x, Catch::Matchers::RangeEquals(std::vector<int>({-1, 0, 1, 2, 3, 4})));
+		REQUIRE(x.contains(4));
+		REQUIRE(*--x.end() == 4);
+	}
+
+	SECTION("Copies share nodes") {
+		vs::persistent_set<int> a{0, 1, 2, 3, 4, 5, 6};
+		vs::persistent_set<int> b = a;
+		b.insert(7);
+		REQUIRE(a.size() == 7);
+		REQUIRE(b.size() == 8);
+		REQUIRE(&*std::as_const(a).find(1) == &*std::as_const(b).find(1));
+		REQUIRE(&*std::as_const(a).find(6) != &*std::as_const(b).find(6));
+	}
+
+	SECTION("Merge keeps shared nodes") {
+		vs::persistent_set<int> a;
+		for (int i = 0; i < 64; i++)
+			a.insert(i);
+		vs::persistent_set<int> b = a;
+		a.insert(-1);
+		b.insert(64);
+
+		std::vector<const int*> before;
+		for (int i = 0; i < 64; i++)
+			before.push_back(&*std::as_const(a).find(i));
+
+		vs::vs_set_strategy<int, std::less<int>>().merge(a, b);
+		REQUIRE(a.size() == 66);
+		/* only the path to the inserted element is copied */
+		int copied = 0;
+		for (int i = 0; i < 64; i++)
+			copied += &*std::as_const(a).find(i) != before[i];
+		REQUIRE(copied < 16);
+	}
+}
+
 TEST_CASE("Test of the vs_queue", "[queue][custom]") {
 	vs::vs_queue<int> x{0, 1, 2, 3};
 	vs::vs_queue<int> y{100, 101, 102, 103};
@@ -197,6 +833,43 @@ TEST_CASE("Test of the vs_queue", "[queue][custom]") {
 	}
 }
 
+TEST_CASE("Test of the vs_queue with persistent_queue", "[queue][persistent]") {
+	typedef vs::vs_queue<int, vs::vs_queue_strategy<int>, vs::persistent_queue<int>> pqueue;
+	pqueue x{0, 1, 2, 3};
+
+	REQUIRE_THAT(x, EqualsQueue(std::queue<int>({0, 1, 2, 3})));
+
+	SECTION("Changing queue in both threads") {
+		auto thread = vs::thread([&x]() {
+			REQUIRE_THAT(x, EqualsQueue(std::queue<int>({0, 1, 2, 3})));
+			x.push(4);
+			REQUIRE(x.back() == 4);
+			REQUIRE_THAT(x, EqualsQueue(std::queue<int>({0, 1, 2, 3, 4})));
+		});
+		x.pop();
+		REQUIRE_THAT(x, EqualsQueue(std::queue<int>({1, 2, 3})));
+		thread.join();
+		REQUIRE_THAT(x, EqualsQueue(std::queue<int>({1, 2, 3, 0, 1, 2, 3, 4})));
+	}
+
+	SECTION("Copies share elements") {
+		vs::persistent_queue<int> a;
+		for (int i = 0; i < 1000000; i++)
+			a.push(i);
+		a.pop();
+
+		vs::persistent_queue<int> b = a;
+		b.pop();
+		b.push(-1);
+		REQUIRE(&a.back() != &b.back());
+		a.pop();
+		REQUIRE(&a.front() == &b.front());
+		REQUIRE(a.size() == 999998);
+		REQUIRE(b.size() == 999999);
+		REQUIRE(b.back() == -1);
+	}
+}
+
 TEST_CASE("Test of the vs_stack", "[stack][custom]") {
 	vs::vs_stack<int> x{0, 1, 2, 3};
 	vs::vs_stack<int> y{100, 101, 102, 103};
@@ -223,6 +896,44 @@ TEST_CASE("Test of the vs_stack", "[stack][custom]") {
 	}
 }
 
+TEST_CASE("Test of the vs_stack with persistent_stack", "[stack][persistent]") {
+	typedef vs::vs_stack<int, vs::vs_stack_strategy<int>, vs::persistent_stack<int>> pstack;
+	typedef vs::vs_stack<int, vs::vs_stack_splice_strategy<int>, vs::persistent_stack<int>> sstack;
+	pstack x{0, 1, 2, 3};
+	sstack y{100, 101, 102, 103};
+
+	REQUIRE_THAT(x, EqualsStack(std::stack<int>({0, 1, 2, 3})));
+	REQUIRE_THAT(y, EqualsStack(std::stack<int>({100, 101, 102, 103})));
+
+	SECTION("Changing stacks in both threads") {
+		auto thread = vs::thread([&x, &y]() {
+			x.push(4);
+			y.pop();
+			y.push(104);
+			y.push(105);
+			REQUIRE_THAT(x, EqualsStack(std::stack<int>({0, 1, 2, 3, 4})));
+			REQUIRE_THAT(y, EqualsStack(std::stack<int>({100, 101, 102, 104, 105})));
+		});
+		x.pop();
+		y.pop();
+		y.pop();
+		REQUIRE_THAT(x, EqualsStack(std::stack<int>({0, 1, 2})));
+		REQUIRE_THAT(y, EqualsStack(std::stack<int>({100, 101})));
+		thread.join();
+		REQUIRE_THAT(x, EqualsStack(std::stack<int>({0, 1, 2, 4, 3, 2, 1, 0})));
+		/* 102 is above the last frame shared with parent, so it comes back */
+		REQUIRE_THAT(y, EqualsStack(std::stack<int>({100, 101, 102, 104, 105})));
+	}
+
+	SECTION("Child takes over untouched stack") {
+		auto thread = vs::thread([&y]() {
+			y.push(104);
+		});
+		thread.join();
+		REQUIRE_THAT(y, EqualsStack(std::stack<int>({100, 101, 102, 103, 104})));
+	}
+}
+
 TEST_CASE("Test of the vs_tree", "[tree][custom]") {
 	vs::vs_tree<int, std::greater<int>> x{0, 1, 2, 3};
 	vs::vs_tree<int> y{100, 101, 102, 103};
@@ -243,4 +954,496 @@ TEST_CASE("Test of the vs_tree", "[tree][custom]") {
 		REQUIRE_THAT(x, EqualsTree(std::vector({1, 3, 4, 2, 0})));
 		REQUIRE_THAT(y, EqualsTree(std::vector({101, 100, 103, 102, 104})));
 	}
-}
\ No newline at end of file
+}
+
+TEST_CASE("Test of the _vs_tree node sharing", "[tree][persistent]") {
+	vs::_vs_tree<int> a;
+	for (int i: {100, 101, 102, 103})
+		a.push(i);
+
+	vs::_vs_tree<int> b = a;
+	REQUIRE(&*a.begin() == &*b.begin());
+
+	SECTION("Insert copies only the path") {
+		b.push(104);
+		REQUIRE_THAT(a, EqualsTree(std::vector({101, 100, 102, 103})));
+		REQUIRE_THAT(b, EqualsTree(std::vector({101, 100, 103, 102, 104})));
+		/* left subtree was not on the insert path */
+		REQUIRE(&*std::as_const(a).find(100) == &*std::as_const(b).find(100));
+	}
+
+	SECTION("Writing through find does not leak to other copies") {
+		*b.find(102) = 42;
+		REQUIRE_THAT(a, EqualsTree(std::vector({101, 100, 102, 103})));
+		REQUIRE_THAT(b, EqualsTree(std::vector({101, 100, 42, 103})));
+	}
+}
+
+/* live and all allocations of CountingAllocator of any type */
+static std::atomic<long> counted_live = 0;
+static std::atomic<long> counted_total = 0;
+
+/* std::allocator that counts what it was asked for */
+template<typename T>
+struct CountingAllocator : std::allocator<T>
+{
+	CountingAllocator() = default;
+
+	template<typename U>
+	CountingAllocator(const CountingAllocator<U>&) { }
+
+	template<typename U>
+	struct rebind { typedef CountingAllocator<U> other; };
+
+	T* allocate(std::size_t n)
+	{
+		counted_live++;
+		counted_total++;
+		return std::allocator<T>::allocate(n);
+	}
+
+	void deallocate(T* p, std::size_t n)
+	{
+		counted_live--;
+		std::allocator<T>::deallocate(p, n);
+	}
+};
+
+TEST_CASE("Test of the vs_tree allocator policy", "[tree][alloc]") {
+	{
+		vs::vs_tree<int, std::less<int>, vs::vs_tree_strategy<int, std::less<int>>, CountingAllocator<int>> x{0, 1, 2, 3};
+		REQUIRE(counted_live == 4);
+
+		auto thread = vs::thread([&x]() {
+			x.push(4);
+		});
+		x.push(5);
+		thread.join();
+
+		REQUIRE(x.size() == 6);
+		REQUIRE(x.find(4) != x.end());
+	}
+	REQUIRE(counted_live == 0);
+
+	{
+		vs::vs_tree<int, std::less<int>, vs::vs_tree_strategy<int, std::less<int>>, CountingAllocator<int>> x;
+		for (int i = 0; i < 1024; i++)
+			x.push(i);
+
+		auto thread = vs::thread([&x]() {
+			x.push(-1);
+		});
+		x.push(1024);
+		long before = counted_total;
+		thread.join();
+
+		/* elements both sides share are not copied by the join */
+		REQUIRE(counted_total - before < 64);
+		REQUIRE(x.size() == 1026);
+	}
+	REQUIRE(counted_live == 0);
+
+	vs::vs_tree<int> y{100, 101, 102, 103};
+	REQUIRE(y.size() == 4);
+}
+
+TEST_CASE("Test of the bulk inserts", "[custom][bulk]") {
+	std::vector<int> sorted;
+	for (int i = 0; i < 1000; i++)
+		sorted.push_back(i);
+
+	SECTION("Ranges into vs_sets") {
+		typedef vs::vs_set<int, std::less<int>, vs::vs_set_strategy<int, std::less<int>>,
+			vs::persistent_set<int>> pset;
+		vs::vs_set<int> x(sorted.begin(), sorted.begin() + 4);
+		pset y(sorted.begin(), sorted.end());
+
+		REQUIRE_THAT(x, Catch::Matchers::UnorderedRangeEquals(std::set<int>({0, 1, 2, 3})));
+		REQUIRE(y.size() == 1000);
+
+		auto thread = vs::thread([&x, &y]() {
+			std::istringstream in("7 3 5");
+			x.insert(std::istream_iterator<int>(in), std::istream_iterator<int>());
+			y.insert_range(std::views::iota(500, 2000));
+			y.insert_range(std::vector({-1, 5000, -2}));
+		});
+		REQUIRE(x.size() == 4);
+		REQUIRE(y.size() == 1000);
+		thread.join();
+
+		REQUIRE_THAT(x, Catch::Matchers::UnorderedRangeEquals(std::set<int>({0, 1, 2, 3, 5, 7})));
+		REQUIRE(y.size() == 2003);
+		REQUIRE(*y.begin() == -2);
+		REQUIRE(*--y.end() == 5000);
+		REQUIRE(std::is_sorted(y.begin(), y.end()));
+	}
+
+	SECTION("Sorted ranges build balanced persistent_set") {
+		vs::persistent_set<int> a(sorted.begin(), sorted.end());
+		vs::persistent_set<int> b = a;
+		b.insert(sorted.begin(), sorted.end());
+		std::vector<int> more({1000, 1001});
+		b.insert(more.begin(), more.end());
+		REQUIRE(a.size() == 1000);
+		REQUIRE(b.size() == 1002);
+		REQUIRE_THAT(a, Catch::Matchers::RangeEquals(sorted));
+	}
+
+	SECTION("Ranges into vs_trees") {
+		vs::vs_tree<int> x(sorted.begin(), sorted.end());
+		vs::vs_tree<int, std::greater<int>> y;
+
+		REQUIRE(x.size() == 1000);
+		REQUIRE(x.height() == 10);
+
+		x.push_range(std::views::iota(1000, 3000));
+		REQUIRE(x.size() == 3000);
+		REQUIRE(x.height() == 12);
+		x.push_range(std::vector({5, -1}));
+		REQUIRE(x.size() == 3002);
+		REQUIRE(x.find(2999) != x.end());
+		REQUIRE(x.find(-1) != x.end());
+
+		y.push_range(std::vector({3, 2, 1, 0}));
+		REQUIRE(y.size() == 4);
+		REQUIRE(y.find(2) != y.end());
+		REQUIRE(y.find(4) == y.end());
+	}
+
+	SECTION("Ranges into vs_queue and vs_stack") {
+		vs::vs_queue<int> q(sorted.begin(), sorted.begin() + 2);
+		vs::vs_stack<int> s;
+
+		q.push_range(std::list({2, 3}));
+		s.push_range(std::list({0, 1, 2}));
+		REQUIRE_THAT(q, EqualsQueue(std::queue<int>({0, 1, 2, 3})));
+		REQUIRE(s.top() == 2);
+		REQUIRE(s.size() == 3);
+	}
+}
+
+/* key that counts how many times it was copied */
+struct CountedKey
+{
+	static inline int copies = 0;
+	int value;
+
+	explicit CountedKey(int v) : value(v) { }
+	CountedKey(const CountedKey& other) : value(other.value) { copies++; }
+	CountedKey(CountedKey&&) = default;
+	CountedKey& operator=(const CountedKey& other) { value = other.value; copies++; return *this; }
+	CountedKey& operator=(CountedKey&&) = default;
+
+	bool operator<(const CountedKey& other) const { return value < other.value; }
+	bool operator==(const CountedKey& other) const { return value == other.value; }
+};
+
+/* joined stack replaces ours, so move-only keys are never copied */
+struct TakeStackStrategy
+{
+	template<typename _Stack>
+	void merge(_Stack& dst, _Stack& src) { dst = src; }
+
+	template<typename _Stack, typename _Key>
+	void merge_same_element(_Stack&, _Key&, _Key&) { }
+};
+
+TEST_CASE("Test of the move semantics", "[custom][move]") {
+	SECTION("Rvalues and emplace do not copy keys") {
+		CountedKey::copies = 0;
+		vs::vs_set<CountedKey> x;
+		vs::vs_tree<CountedKey> y;
+		vs::vs_queue<CountedKey> q;
+		vs::vs_stack<CountedKey, vs::vs_stack_strategy<CountedKey>, vs::persistent_stack<CountedKey>> s;
+
+		REQUIRE(x.insert(CountedKey(1)));
+		REQUIRE(x.emplace(2));
+		REQUIRE_FALSE(x.emplace(2));
+		y.push(CountedKey(1));
+		y.emplace(2);
+		q.push(CountedKey(1));
+		q.emplace(2);
+		s.push(CountedKey(1));
+		s.emplace(2);
+		REQUIRE(CountedKey::copies == 0);
+
+		REQUIRE(x.size() == 2);
+		REQUIRE(y.find(CountedKey(2)) != y.end());
+		REQUIRE(q.front().value == 1);
+		REQUIRE(s.top().value == 2);
+
+		CountedKey key(3);
+		x.insert(key);
+		REQUIRE(CountedKey::copies == 1);
+	}
+
+	SECTION("Move-only keys with persistent_stack") {
+		typedef std::unique_ptr<int> ptr;
+		vs::vs_stack<ptr, TakeStackStrategy, vs::persistent_stack<ptr>> s;
+
+		s.push(std::make_unique<int>(1));
+		s.emplace(new int(2));
+
+		int seen = 0;
+		auto thread = vs::thread([&s, &seen]() {
+			seen = *s.top();
+			s.push(std::make_unique<int>(3));
+		});
+		thread.join();
+
+		REQUIRE(seen == 2);
+		REQUIRE(s.size() == 3);
+		REQUIRE(*s.top() == 3);
+		s.pop();
+		REQUIRE(*s.top() == 2);
+	}
+
+	SECTION("Moving containers and Versioned") {
+		vs::vs_set<std::string> a{"a", "b"};
+		std::string c(100, 'c');
+		a.insert(std::move(c));
+		REQUIRE(a.contains(std::string(100, 'c')));
+
+		vs::vs_set<std::string> b(std::move(a));
+		REQUIRE(b.size() == 3);
+		a = vs::vs_set<std::string>{"d"};
+		REQUIRE_THAT(a, Catch::Matchers::RangeEquals(std::vector<std::string>({"d"})));
+		a = b;
+		REQUIRE(a.size() == 3);
+		REQUIRE(b.size() == 3);
+
+		Versioned<std::string> v(std::string(100, 'v'));
+		Versioned<std::string> w(std::move(v));
+		REQUIRE(w.Get() == std::string(100, 'v'));
+
+		/* version of parent Segment is shared with it, so it is copied */
+		std::size_t moved = 0;
+		auto thread = vs::thread([&w, &moved]() {
+			Versioned<std::string> u(std::move(w));
+			moved = u.Get().size();
+		});
+		thread.join();
+		REQUIRE(moved == 100);
+		REQUIRE(w.Get() == std::string(100, 'v'));
+	}
+}
+
+TEST_CASE("Test of the ownership transfer", "[int][transfer]") {
+	Versioned<CountedKey> x(CountedKey(0));
+	CountedKey::copies = 0;
+	std::vector<int> seen;
+
+	SECTION("Only parent writes") {
+		for (int i = 0; i < 4; i++) {
+			auto thread = vs::thread([&x, &seen]() { seen.push_back(x.Get().value); });
+			thread.join();
+			x.Update([](CountedKey& k) { k.value++; return true; });
+		}
+
+		/* versions are collapsed and updated with no copies */
+		REQUIRE(CountedKey::copies == 0);
+		REQUIRE(seen == std::vector<int>({0, 1, 2, 3}));
+		REQUIRE(x.Get().value == 4);
+	}
+
+	SECTION("Only child writes") {
+		for (int i = 0; i < 4; i++) {
+			auto thread = vs::thread([&x]() { x.Update([](CountedKey& k) { k.value++; return true; }); });
+			thread.join();
+			seen.push_back(x.Get().value);
+		}
+
+		/* fork shares the value with parent, so child copies it, but join takes it back */
+		REQUIRE(CountedKey::copies == 4);
+		REQUIRE(seen == std::vector<int>({1, 2, 3, 4}));
+	}
+
+	SECTION("Shared values are copied") {
+		int child = 0;
+		auto thread = vs::thread([&x, &child]() {
+			x.Update([](CountedKey& k) { k.value = 10; return true; });
+			child = x.Get().value;
+		});
+		x.Update([](CountedKey& k) { k.value = 20; return true; });
+		REQUIRE(x.Get().value == 20);
+		thread.join();
+
+		/* both first writes copy the value they share */
+		REQUIRE(CountedKey::copies >= 2);
+		REQUIRE(child == 10);
+		REQUIRE(x.Get().value == 10);
+	}
+}
+
+TEST_CASE("Test of the snapshots", "[custom][snapshot]") {
+	SECTION("vs_set snapshot is frozen") {
+		vs::vs_set<int> set({1, 2, 3});
+		auto snap = set.snapshot();
+
+		set.insert(4);
+		auto thread = vs::thread([&set]() { set.insert(5); });
+		thread.join();
+		REQUIRE(set.size() == 5);
+		REQUIRE_THAT(*snap, Catch::Matchers::RangeEquals(std::set<int>({1, 2, 3})));
+
+		/* plain thread reads it with no Revision */
+		int sum = 0;
+		std::thread reader([&snap, &sum]() {
+			for (int x: snap)
+				sum += x;
+		});
+		reader.join();
+		REQUIRE(sum == 6);
+
+		/* copy keeps it pinned after the original is dropped */
+		auto copy = snap;
+		snap.reset();
+		REQUIRE(!snap);
+		set.insert(6);
+		REQUIRE(copy->size() == 3);
+		REQUIRE(copy->count(4) == 0);
+	}
+
+	SECTION("vs_tree snapshot is frozen") {
+		vs::vs_tree<int> tree{5, 3, 8};
+		auto snap = tree.snapshot();
+		tree.push(1);
+
+		REQUIRE(tree.size() == 4);
+		REQUIRE(snap->size() == 3);
+		REQUIRE(snap->find(1) == snap->end());
+		REQUIRE(snap->find(8) != snap->end());
+	}
+
+	SECTION("Snapshot taken in a child survives the join") {
+		vs::vs_queue<int> queue;
+		vs::vs_stack<int> stack;
+		decltype(queue.snapshot()) qsnap;
+		decltype(stack.snapshot()) ssnap;
+
+		auto thread = vs::thread([&]() {
+			queue.push(1);
+			queue.push(2);
+			stack.push(1);
+			stack.push(2);
+			qsnap = queue.snapshot();
+			ssnap = stack.snapshot();
+		});
+		queue.push(10);
+		stack.push(10);
+		thread.join();
+
+		/* both sides wrote, so strategies ran on the pinned versions */
+		REQUIRE(queue.size() == 3);
+		REQUIRE(stack.size() == 3);
+		REQUIRE(qsnap->size() == 2);
+		REQUIRE(qsnap->front() == 1);
+		REQUIRE(qsnap->back() == 2);
+		REQUIRE(ssnap->size() == 2);
+		REQUIRE(ssnap->top() == 2);
+
+		std::vector<int> drained;
+		while (queue.size() > 0) {
+			drained.push_back(queue.front());
+			queue.pop();
+		}
+		REQUIRE(drained == std::vector<int>({10, 1, 2}));
+	}
+
+	SECTION("Released snapshot is collapsed") {
+		Versioned<int> x(0);
+		x.Set(1);
+		{
+			vs::snapshot<int> snap(x);
+			x.Set(2);
+			REQUIRE(*snap == 1);
+			REQUIRE(x.versions.size() == 2);
+		}
+
+		auto thread = vs::thread([]() {});
+		thread.join();
+		REQUIRE(x.Get() == 2);
+		REQUIRE(x.versions.size() == 1);
+	}
+}
+
+TEST_CASE("Test of the statistics", "[int][stats]") {
+	ResetStats();
+	{
+		Versioned<std::vector<int>> x(std::vector<int>({1, 2, 3}));
+		auto thread = vs::thread([&x]() { x.Update([](std::vector<int>& v) { v.push_back(4); return true; }); });
+		thread.join();
+		REQUIRE(x.Get().size() == 4);
+
+		StatsSnapshot stats = CollectStats();
+		std::string json = StatsToJson(stats);
+		std::string prom = StatsToPrometheus(stats);
+
+		if constexpr (statsEnabled) {
+			REQUIRE(stats.forks >= 1);
+			REQUIRE(stats.joins >= 1);
+			REQUIRE(stats.joinTime.count == stats.joins);
+			/* child copies the shared value, join takes it back */
+			REQUIRE(stats.copies >= 1);
+			REQUIRE(stats.bytesCopied >= sizeof(std::vector<int>) + 3 * sizeof(int));
+			REQUIRE(stats.moves >= 2);
+			REQUIRE(stats.gets >= 1);
+			REQUIRE(stats.liveVersions() == (std::int64_t)x.versions.size());
+			REQUIRE(std::any_of(stats.strategies.begin(), stats.strategies.end(), [](const auto& s) {
+				return s.first.find("DefaultMergeStrategy") != std::string::npos && s.second.merge.count >= 1;
+			}));
+			REQUIRE(json.find("\"enabled\": true") != std::string::npos);
+			REQUIRE(prom.find("vs_merge_nanoseconds_count{strategy=") != std::string::npos);
+		} else {
+			REQUIRE(stats.copies == 0);
+			REQUIRE(stats.gets == 0);
+			REQUIRE(json.find("\"enabled\": false") != std::string::npos);
+		}
+		REQUIRE(prom.find("vs_copies_total ") != std::string::npos);
+	}
+
+	if constexpr (statsEnabled)
+		REQUIRE(CollectStats().liveVersions() == 0);
+
+	std::string path = (std::filesystem::temp_directory_path() / "vs_stats_test.prom").string();
+	REQUIRE(DumpStats(path, StatsFormat::Prometheus));
+	std::ifstream in(path);
+	std::string dumped((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	REQUIRE(dumped.find("# TYPE vs_live_versions gauge") != std::string::npos);
+	std::filesystem::remove(path);
+}
+
+TEST_CASE("Test of the trace", "[int][trace]") {
+	ResetTrace();
+	{
+		Versioned<int> x(0);
+		auto thread = vs::thread([&x]() { x.Set(1); });
+		thread.join();
+		REQUIRE(x.Get() == 1);
+	}
+
+	std::string json = TraceToJson();
+	REQUIRE(json.find("\"traceEvents\": [") != std::string::npos);
+
+	if constexpr (traceEnabled) {
+		for (const char* name: {"fork", "join", "merge", "collapse", "release"})
+			REQUIRE(json.find(std::string("\"name\": \"") + name + "\"") != std::string::npos);
+		REQUIRE(json.find("\"ph\": \"X\"") != std::string::npos);
+
+		/* events of the ring buffer that were overwritten are not exported */
+		ResetTrace();
+		for (std::size_t i = 0; i < Trace::capacity + 10; i++)
+			Trace::Instant("test", "i", i);
+		json = TraceToJson();
+		REQUIRE(json.find("\"i\": 9}") == std::string::npos);
+		REQUIRE(json.find("\"i\": 10}") != std::string::npos);
+		REQUIRE(json.find("\"name\": \"fork\"") == std::string::npos);
+	} else {
+		REQUIRE(json.find("\"name\"") == std::string::npos);
+	}
+
+	std::string path = (std::filesystem::temp_directory_path() / "vs_trace_test.json").string();
+	REQUIRE(DumpTrace(path));
+	REQUIRE(std::filesystem::file_size(path) > 0);
+	std::filesystem::remove(path);
+}